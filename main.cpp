@@ -1,5 +1,6 @@
 #include<string>
 #include<chrono>
+#include<thread>
 #include<iostream>
 #include<GL/glew.h>
 #include<glm/glm.hpp>
@@ -123,30 +124,31 @@ int main(void) {
 
     auto offsetLocation = glGetUniformLocation(shader_programme, "offset");
     
-    auto time_of_last_frame = std::chrono::system_clock::now();
-    auto t_i = time_of_last_frame;
-    auto t_im1 = time_of_last_frame;
+    // Frames are paced on steady_clock, sleeping until the next one is due rather than spinning
+    auto frame = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(SECONDS_BETWEEN_FRAMES));
+    auto next_frame = std::chrono::steady_clock::now();
+    auto t_im1 = next_frame;
 
     do {
-        auto t_i = std::chrono::system_clock::now();
+        auto t_i = std::chrono::steady_clock::now();
         // Handle input
         std::chrono::duration<double> dt = t_i - t_im1;
         processInput(window, dt.count());
-        
-        // Only draw the last frame at the correct framerate
-        std::chrono::duration<double> delta_t = t_i - time_of_last_frame;
-        if ( delta_t.count() > SECONDS_BETWEEN_FRAMES ) {
-            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-            glClear( GL_COLOR_BUFFER_BIT );
-            glUseProgram(shader_programme);
-            glUniform2f(offsetLocation, x, y);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-            time_of_last_frame = std::chrono::system_clock::now();
-        }
+
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear( GL_COLOR_BUFFER_BIT );
+        glUseProgram(shader_programme);
+        glUniform2f(offsetLocation, x, y);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
         t_im1 = t_i;
+
+        next_frame += frame;
+        if (next_frame < t_i)
+            next_frame = t_i + frame;   // fell behind; don't try to catch up
+        std::this_thread::sleep_until(next_frame);
     } // Check if the ESC key was pressed or the window was closed
     while( glfwWindowShouldClose(window) == 0 );
     
@@ -0,0 +1,289 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "State.hpp"
+
+// Variable-resolution action-value function: a kd-tree over (angle, angular momentum) whose leaves
+// each hold one value per action.  It starts as a coarse uniform grid and halves a leaf once it has
+// been visited often, or sooner if its TD errors vary a lot, which means the value differs across
+// the cell.  Cells get small wherever training spends its time, so to resolve the balance point
+// training has to visit it (see adaptive.cpp's upright starts).
+//
+// The tree is a flat array of 8 byte nodes.  The first ones are the cells of the starting grid, so
+// a lookup indexes its way past the top levels.  Below them an internal node holds its split point
+// and the index of its first child; the second child is right after it, so a lookup steps down
+// with child + (x >= split) and only branches on whether it has reached a leaf.  Leaf values and the
+// statistics used for splitting live in separate arrays, keeping the nodes dense in cache.
+// Coordinates are normalized to [0, 1]: angle() from -pi to pi, and momentum clamped to
+// [MIN_VELOCITY, MAX_VELOCITY].  Cells are split at their midpoints.
+//
+// Every array is reserved for maxLeaves up front, so training doesn't allocate once the tree is
+// built.
+
+struct AdaptiveConfig {
+    int initialDepth = 8;           // 2^8 cells to start, split alternately: 16 x 16
+    int maxAxisDepth = 14;          // finest cell is 2^-14 of a range on either axis
+    uint32_t maxLeaves = 1 << 15;
+    uint32_t minVisits = 16;        // visits before the variance can trigger a split
+    uint32_t splitVisits = 128;     // visits that always split
+    float varianceThreshold = 4;    // TD error variance that splits after minVisits
+};
+
+class AdaptiveValue {
+public:
+    using Values = ActionValues<NUM_ACTIONS>;
+    static constexpr uint32_t LEAF = 0x80000000u;
+
+    // A leaf's extent, in state units
+    struct Cell {
+        double angleLo, angleHi;
+        double LLo, LHi;
+    };
+
+private:
+    struct Node {
+        float split;
+        uint32_t next;      // LEAF | leaf index, or first child << 1 | axis
+    };
+
+    // Splitting statistics, only touched when a leaf is updated
+    struct LeafStats {
+        float lo[2], hi[2];
+        uint8_t depth[2];
+        uint32_t visits;
+        float meanDelta, m2;
+        // TD error sums in the lower and upper half of the cell along each axis
+        float halfSum[2][2];
+        uint32_t halfCount[2][2];
+    };
+
+    AdaptiveConfig config;
+    uint32_t gridAngle, gridVelocity;
+    std::vector<Node> nodes;        // the starting grid's cells first, row by row
+    std::vector<Values> values_;
+    std::vector<LeafStats> stats;
+    size_t splits = 0;
+
+    static float angleCoord(double theta) {
+        return float((angle(theta) + M_PI) * (0.5 / M_PI));
+    }
+
+    static float velocityCoord(double L) {
+        return float(std::min(std::max((L - MIN_VELOCITY) / (MAX_VELOCITY - MIN_VELOCITY), 0.0), 1.0));
+    }
+
+    static LeafStats fresh(const float lo[2], const float hi[2], const uint8_t depth[2]) {
+        LeafStats s{};
+        for (int d = 0; d < 2; d++) {
+            s.lo[d] = lo[d];
+            s.hi[d] = hi[d];
+            s.depth[d] = depth[d];
+        }
+        return s;
+    }
+
+    // Turns node n, holding leaf l, into an internal node with two leaves.  The left child keeps
+    // l and the right gets a new leaf; both start from the parent's values.
+    void split(uint32_t n, uint32_t l, int axis) {
+        const LeafStats parent = stats[l];
+        float mid = 0.5f * (parent.lo[axis] + parent.hi[axis]);
+        uint32_t child = uint32_t(nodes.size());
+        uint32_t right = uint32_t(values_.size());
+        nodes[n] = Node{mid, child << 1 | uint32_t(axis)};
+        nodes.push_back(Node{0, LEAF | l});
+        nodes.push_back(Node{0, LEAF | right});
+        values_.push_back(values_[l]);
+
+        float lo[2] = {parent.lo[0], parent.lo[1]}, hi[2] = {parent.hi[0], parent.hi[1]};
+        uint8_t depth[2] = {parent.depth[0], parent.depth[1]};
+        depth[axis]++;
+        hi[axis] = mid;
+        stats[l] = fresh(lo, hi, depth);
+        hi[axis] = parent.hi[axis];
+        lo[axis] = mid;
+        stats.push_back(fresh(lo, hi, depth));
+        splits++;
+    }
+
+    // Node index of the leaf containing (u, v)
+    uint32_t find(float u, float v) const {
+        uint32_t i = std::min(uint32_t(u * gridAngle), gridAngle - 1)
+                   + gridAngle * std::min(uint32_t(v * gridVelocity), gridVelocity - 1);
+        const Node* t = nodes.data();
+        while (not (t[i].next & LEAF))
+            i = (t[i].next >> 1) + ((t[i].next & 1 ? v : u) >= t[i].split);
+        return i;
+    }
+
+public:
+    AdaptiveValue(const AdaptiveConfig& config = AdaptiveConfig()):
+        config(config),
+        gridAngle(1u << (config.initialDepth + 1) / 2),
+        gridVelocity(1u << config.initialDepth / 2)
+    {
+        size_t cells = size_t(gridAngle) * gridVelocity;
+        size_t capacity = std::max<size_t>(config.maxLeaves, cells);
+        nodes.reserve(2 * capacity);
+        values_.reserve(capacity);
+        stats.reserve(capacity);
+        uint8_t depth[2] = {uint8_t((config.initialDepth + 1) / 2), uint8_t(config.initialDepth / 2)};
+        for (uint32_t j = 0; j < gridVelocity; j++)
+            for (uint32_t i = 0; i < gridAngle; i++) {
+                float lo[2] = {float(i) / gridAngle, float(j) / gridVelocity};
+                float hi[2] = {float(i + 1) / gridAngle, float(j + 1) / gridVelocity};
+                nodes.push_back(Node{0, LEAF | uint32_t(values_.size())});
+                values_.push_back(Values{});
+                stats.push_back(fresh(lo, hi, depth));
+            }
+    }
+
+    // Leaf holding x
+    uint32_t leaf(const State& x) const {
+        return nodes[find(angleCoord(x.theta), velocityCoord(x.L))].next & ~LEAF;
+    }
+
+    const Values& values(uint32_t leaf) const {
+        return values_[leaf];
+    }
+
+    Values values(const State& x) const {
+        return values_[leaf(x)];
+    }
+
+    float operator() (const State& x, Action a) const {
+        return values(x)[a];
+    }
+
+    void update(uint32_t leaf, Action a, float step) {
+        values_[leaf].q[static_cast<size_t>(a)] += step;
+    }
+
+    // Accounts for a TD error delta observed at x, which lies in leaf, and splits the leaf if it
+    // has earned it.  Returns whether it split.
+    bool record(uint32_t leaf, const State& x, float delta) {
+        LeafStats& s = stats[leaf];
+        s.visits++;
+        float d = delta - s.meanDelta;
+        s.meanDelta += d / s.visits;
+        s.m2 += d * (delta - s.meanDelta);
+        float c[2] = {angleCoord(x.theta), velocityCoord(x.L)};
+        for (int axis = 0; axis < 2; axis++) {
+            int upper = c[axis] >= 0.5f * (s.lo[axis] + s.hi[axis]);
+            s.halfSum[axis][upper] += delta;
+            s.halfCount[axis][upper]++;
+        }
+
+        if (s.visits < config.minVisits or leaves() >= config.maxLeaves)
+            return false;
+        float variance = s.m2 / (s.visits - 1);
+        if (s.visits < config.splitVisits and variance < config.varianceThreshold)
+            return false;
+
+        // Split where the two halves disagree most about the TD error, among axes that can still be split
+        int axis = -1;
+        float best = -1;
+        for (int k = 0; k < 2; k++) {
+            if (s.depth[k] >= config.maxAxisDepth)
+                continue;
+            float low = s.halfCount[k][0] ? s.halfSum[k][0] / s.halfCount[k][0] : 0;
+            float high = s.halfCount[k][1] ? s.halfSum[k][1] / s.halfCount[k][1] : 0;
+            float gap = std::fabs(high - low);
+            if (gap > best) {
+                best = gap;
+                axis = k;
+            }
+        }
+        if (axis < 0)
+            return false;
+        split(find(c[0], c[1]), leaf, axis);
+        return true;
+    }
+
+    // Rewrites the nodes breadth first below the starting grid, so that the upper levels of the
+    // subtrees are contiguous
+    void compact(void) {
+        size_t cells = size_t(gridAngle) * gridVelocity;
+        std::vector<Node> out;
+        out.reserve(nodes.capacity());
+        out.insert(out.end(), nodes.begin(), nodes.begin() + cells);
+        for (size_t i = 0; i < out.size(); i++) {
+            if (out[i].next & LEAF)
+                continue;
+            uint32_t child = out[i].next >> 1;
+            uint32_t axis = out[i].next & 1;
+            out[i].next = uint32_t(out.size()) << 1 | axis;
+            out.push_back(nodes[child]);
+            out.push_back(nodes[child + 1]);
+        }
+        nodes.swap(out);
+    }
+
+    size_t leaves(void) const {
+        return values_.size();
+    }
+
+    size_t splitCount(void) const {
+        return splits;
+    }
+
+    // Memory needed for lookups: nodes and leaf values
+    size_t bytes(void) const {
+        return nodes.size() * sizeof(Node) + values_.size() * sizeof(Values);
+    }
+
+    // Memory only used while learning
+    size_t trainingBytes(void) const {
+        return stats.size() * sizeof(LeafStats);
+    }
+
+    Cell cell(uint32_t leaf) const {
+        const LeafStats& s = stats[leaf];
+        double dL = MAX_VELOCITY - MIN_VELOCITY;
+        return Cell{2 * M_PI * s.lo[0] - M_PI, 2 * M_PI * s.hi[0] - M_PI,
+                    MIN_VELOCITY + dL * s.lo[1], MIN_VELOCITY + dL * s.hi[1]};
+    }
+
+    Action greedy(const State& x, double eps = 1) const {
+        if (uniform() < eps)
+            return ActionValue<>::argmax(values(x));
+        else
+            return static_cast<Action>(uniformInt(0, NUM_ACTIONS));
+    }
+};
+
+// One-step SARSA on an AdaptiveValue, with the interface runEpisode() trains
+class AdaptiveAgent {
+private:
+    float alpha;
+    float gamma;
+    AdaptiveValue Q;
+    float delta = 0;
+
+public:
+    AdaptiveAgent(float alpha = 0.2f, float gamma = 0.75f, const AdaptiveConfig& config = AdaptiveConfig()):
+        alpha(alpha), gamma(gamma), Q(config) {}
+
+    void beginEpisode(void) {}
+
+    void updateSarsa(const State& cur, Action curAct, double reward, const State& prev, Action prevAct) {
+        uint32_t l = Q.leaf(prev);
+        double target = cur.broken ? reward : reward + gamma * Q(cur, curAct);
+        delta = target - Q.values(l)[prevAct];
+        Q.update(l, prevAct, alpha * delta);
+        Q.record(l, prev, delta);
+    }
+
+    float tdError(void) const {
+        return delta;
+    }
+
+    Action greedy(const State& x, double epsilon = 1) const {
+        return Q.greedy(x, epsilon);
+    }
+
+    AdaptiveValue& values(void) {
+        return Q;
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations so we can check that the training hot path never touches the heap.
+// Building with -DCOUNT_ALLOCS replaces every global operator new, the nothrow and over-aligned
+// (std::align_val_t) forms included, so an alignas(64) type can't slip past the count; without it
+// nothing is counted and allocations() stays at 0.
+
+#ifdef COUNT_ALLOCS
+constexpr bool ALLOC_COUNTING = true;
+#else
+constexpr bool ALLOC_COUNTING = false;
+#endif
+
+std::atomic<size_t> allocationCount{0};
+
+size_t allocations(void) {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+#ifdef COUNT_ALLOCS
+// Every operator delete frees through here.  Kept out of line so that GCC doesn't inline free()
+// into callers and warn that it doesn't match the operator new they called.
+[[gnu::noinline]] void releaseAllocation(void* p) noexcept {
+    std::free(p);
+}
+
+void* operator new(size_t n) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n) {
+    return operator new(n);
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+
+void* operator new[](size_t n, const std::nothrow_t& tag) noexcept {
+    return operator new(n, tag);
+}
+
+// aligned_alloc wants a size that is a multiple of the alignment.  Its memory goes back through
+// free() like the rest.
+void* operator new(size_t n, std::align_val_t al, const std::nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t a = static_cast<size_t>(al);
+    return std::aligned_alloc(a, (std::max<size_t>(n, 1) + a - 1) / a * a);
+}
+
+void* operator new(size_t n, std::align_val_t al) {
+    if (void* p = operator new(n, al, std::nothrow))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n, std::align_val_t al) {
+    return operator new(n, al);
+}
+
+void* operator new[](size_t n, std::align_val_t al, const std::nothrow_t& tag) noexcept {
+    return operator new(n, al, tag);
+}
+
+void operator delete(void* p) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete[](void* p) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    releaseAllocation(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    releaseAllocation(p);
+}
+#endif
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "State.hpp"
+#include "FastMath.hpp"
+
+// Maximum deviation from the scalar update() after one action interval (PHYSICS_STEPS_PER_ACTION
+// substeps) for a pendulum that doesn't break.  The batched path uses fastSin() instead of std::sin
+// and multiplies by dt / I instead of dividing by I, each a few ulp per substep; that error
+// compounds through the integrator over the interval, so we allow well above machine epsilon
+// while still catching any real bug.  Measured deviations are around 1e-13.  Fast math builds wrap
+// theta here exactly as update() does.
+constexpr double BATCH_TOLERANCE = 1e-9;
+
+// Pendulums advanced together by one block of the AVX kernel
+constexpr int BATCH_LANES = 16;
+
+// N pendulums stored as structure-of-arrays so that update() can advance several of them per
+// instruction.  Broken pendulums are frozen until they are reset with set().
+class BatchEnvironment {
+public:
+    std::vector<double> theta;
+    std::vector<double> L;
+    std::vector<uint8_t> tl_on;
+    std::vector<uint8_t> tr_on;
+    std::vector<uint8_t> broken;
+
+    BatchEnvironment(size_t n): theta(n, 0), L(n, 0), tl_on(n, 0), tr_on(n, 0), broken(n, 0) {}
+
+    size_t size(void) const {
+        return theta.size();
+    }
+
+    void set(size_t i, const State& x) {
+        theta[i] = x.theta;
+        L[i] = x.L;
+        tl_on[i] = x.tl_on;
+        tr_on[i] = x.tr_on;
+        broken[i] = x.broken;
+    }
+
+    State get(size_t i) const {
+        return State{theta[i], L[i], bool(tl_on[i]), bool(tr_on[i]), bool(broken[i])};
+    }
+
+    // Same semantics as act() for every pendulum
+    void act(const Action* actions) {
+        for (size_t i = 0; i < size(); i++) {
+            switch (actions[i]) {
+            case Action::off:
+                tl_on[i] = 0;
+                tr_on[i] = 0;
+                break;
+            case Action::torqueL:
+                tl_on[i] = 1;
+                break;
+            case Action::torqueR:
+                tr_on[i] = 1;
+                break;
+            }
+        }
+    }
+
+    // Equivalent to calling update() substeps times on every unbroken pendulum.  Each block of
+    // pendulums stays in registers for all of the substeps.
+    void update(int substeps = 1) {
+        size_t n = size();
+        size_t i = 0;
+#ifdef __AVX__
+        // BATCH_LANES pendulums per block, as several independent vectors so that the latency of
+        // one vector's sine is hidden behind the others
+        const __m256d dt = _mm256_set1_pd(PHYSICS_TIMESTEP);
+        const __m256d dtOverInertia = _mm256_set1_pd(PHYSICS_TIMESTEP / MOMENT_OF_INERTIA);
+        const __m256d gravity = _mm256_set1_pd(MASS * GRAVITY_FORCE);
+        constexpr int VECTORS = BATCH_LANES / 4;
+        for (; i + BATCH_LANES <= n; i += BATCH_LANES) {
+            alignas(32) double torque[BATCH_LANES];
+            alignas(32) double live[BATCH_LANES];
+            for (int j = 0; j < BATCH_LANES; j++) {
+                torque[j] = (tl_on[i + j] ? TORQUE_L : 0) + (tr_on[i + j] ? TORQUE_R : 0);
+                live[j] = broken[i + j] ? 0.0 : -1.0; // sign bit set selects the updated value
+            }
+            __m256d t[VECTORS], th[VECTORS], l[VECTORS];
+            for (int v = 0; v < VECTORS; v++) {
+                t[v] = _mm256_load_pd(&torque[4 * v]);
+                th[v] = _mm256_loadu_pd(&theta[i + 4 * v]);
+                l[v] = _mm256_loadu_pd(&L[i + 4 * v]);
+            }
+
+            for (int s = 0; s < substeps; s++) {
+                for (int v = 0; v < VECTORS; v++) {
+                    __m256d F = _mm256_sub_pd(t[v], _mm256_mul_pd(gravity, fastSin(th[v])));
+                    l[v] = _mm256_add_pd(l[v], _mm256_mul_pd(F, dtOverInertia));
+                    th[v] = _mm256_add_pd(th[v], _mm256_mul_pd(dt, l[v]));
+#ifdef BALANCE_FAST_MATH
+                    th[v] = rewrap(th[v]);
+#endif
+                }
+            }
+
+            for (int v = 0; v < VECTORS; v++) {
+                __m256d mask = _mm256_load_pd(&live[4 * v]);
+                _mm256_storeu_pd(&theta[i + 4 * v], _mm256_blendv_pd(_mm256_loadu_pd(&theta[i + 4 * v]), th[v], mask));
+                _mm256_storeu_pd(&L[i + 4 * v], _mm256_blendv_pd(_mm256_loadu_pd(&L[i + 4 * v]), l[v], mask));
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            if (broken[i])
+                continue;
+            double torque = (tl_on[i] ? TORQUE_L : 0) + (tr_on[i] ? TORQUE_R : 0);
+            double th = theta[i];
+            double l = L[i];
+            for (int s = 0; s < substeps; s++) {
+                double F = torque - MASS * GRAVITY_FORCE * fastSin(th);
+                l += F * (PHYSICS_TIMESTEP / MOMENT_OF_INERTIA);
+                th += PHYSICS_TIMESTEP * l;
+#ifdef BALANCE_FAST_MATH
+                th = rewrap(th);
+#endif
+            }
+            theta[i] = th;
+            L[i] = l;
+        }
+    }
+
+    // Environment::reward for every pendulum, given the action each one took.  Marks pendulums
+    // whose angular momentum left the allowed range as broken.
+    void reward(const Action* actions, double* out) {
+        for (size_t i = 0; i < size(); i++) {
+            if (L[i] > MAX_VELOCITY or L[i] < MIN_VELOCITY) {
+                broken[i] = 1;
+                out[i] = -100;
+                continue;
+            }
+            double a = angle(theta[i]);
+            double act = (actions[i] == Action::off) ? 0 : 1;
+            out[i] = -(a * a + L[i] * L[i] + act);
+        }
+    }
+};
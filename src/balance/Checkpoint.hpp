@@ -0,0 +1,199 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "State.hpp"
+#include "Quantized.hpp"
+
+// Binary checkpoints of an Agent: a 64 byte header followed by the raw ActionValue weights.  Loading
+// maps the file copy-on-write, so a trained agent is usable as soon as the header is checked and
+// pages of the table are only read in as they're touched.  Training on a loaded agent never writes
+// back to the file.
+//
+// The weights can also be stored as fp16 or int8 (see Quantized.hpp).  Those load by widening them
+// back to floats in memory, so every tool that reads a checkpoint reads them too.
+
+constexpr char CHECKPOINT_MAGIC[4] = {'R', 'M', 'L', 'Q'};
+// Version 2 stores the action values of each feature side by side; version 3 adds the weight
+// format, in what were the high bits of tilings, so version 2 files read as f32
+constexpr uint32_t CHECKPOINT_VERSION = 3;
+
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t angularBuckets;
+    uint32_t velocityBuckets;
+    uint32_t numActions;
+    uint16_t tilings;
+    uint16_t format;    // WeightFormat
+    uint64_t hashSize;
+    uint64_t weights;
+    float alpha;
+    float gamma;
+    double epsC;
+    uint64_t step;  // decisions taken so far, so the exploration schedule resumes where it left off
+};
+static_assert(sizeof(CheckpointHeader) == 64, "weights must start on a cache line");
+
+struct Checkpoint {
+    std::unique_ptr<Agent> agent;
+    double epsC = EPSILON_C;
+    size_t step = 0;
+};
+
+template<typename Table>
+CheckpointHeader checkpointHeader(const Table& Q, float alpha, float gamma, WeightFormat format, double epsC, size_t step) {
+    CheckpointHeader h;
+    std::memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.version = CHECKPOINT_VERSION;
+    h.angularBuckets = ANGULAR_BUCKETS;
+    h.velocityBuckets = VELOCITY_BUCKETS;
+    h.numActions = NUM_ACTIONS;
+    h.tilings = Q.coder().numTilings();
+    h.format = static_cast<uint16_t>(format);
+    h.hashSize = Q.coder().hashSize();
+    h.weights = Q.size();
+    h.alpha = alpha;
+    h.gamma = gamma;
+    h.epsC = epsC;
+    h.step = step;
+    return h;
+}
+
+// Writes to a temporary file and renames it into place, so a snapshot taken while training is
+// never seen half written.  write(FILE*) writes the weights.
+template<typename Write>
+bool writeCheckpoint(const std::string& path, const CheckpointHeader& h, Write write) {
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        fprintf(stderr, "Failed to open %s for writing\n", tmp.c_str());
+        return false;
+    }
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 and write(f);
+    ok = (std::fclose(f) == 0) and ok;
+    if (not ok or std::rename(tmp.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Failed to write checkpoint %s\n", path.c_str());
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Quantizing rounds each weight to nearest; the agent itself keeps its float table
+bool saveCheckpoint(const std::string& path, Agent& agent, double epsC = EPSILON_C, size_t step = 0,
+                    WeightFormat format = WeightFormat::f32) {
+    const ActionValue<>& Q = agent.values();
+    CheckpointHeader h = checkpointHeader(Q, agent.stepSize(), agent.discount(), format, epsC, step);
+    switch (format) {
+    case WeightFormat::f16:
+        return writeCheckpoint(path, h, [&](FILE* f) { return QuantizedValue<WeightFormat::f16>(Q).write(f); });
+    case WeightFormat::i8:
+        return writeCheckpoint(path, h, [&](FILE* f) { return QuantizedValue<WeightFormat::i8>(Q).write(f); });
+    default:
+        return writeCheckpoint(path, h, [&](FILE* f) {
+            return std::fwrite(Q.data(), sizeof(float), Q.size(), f) == Q.size();
+        });
+    }
+}
+
+// A quantized agent's weights as they are, without widening them
+template<WeightFormat Format>
+bool saveCheckpoint(const std::string& path, const QuantizedAgent<Format>& agent, double epsC = EPSILON_C, size_t step = 0) {
+    const QuantizedValue<Format>& Q = agent.values();
+    CheckpointHeader h = checkpointHeader(Q, agent.stepSize(), agent.discount(), Format, epsC, step);
+    return writeCheckpoint(path, h, [&](FILE* f) { return Q.write(f); });
+}
+
+// Bytes of weights following the header
+inline size_t payloadBytes(const CheckpointHeader& h) {
+    switch (static_cast<WeightFormat>(h.format)) {
+    case WeightFormat::f16:
+        return QuantizedValue<WeightFormat::f16>::payloadBytes(h.weights);
+    case WeightFormat::i8:
+        return QuantizedValue<WeightFormat::i8>::payloadBytes(h.weights);
+    default:
+        return h.weights * sizeof(float);
+    }
+}
+
+template<WeightFormat Format>
+std::unique_ptr<ActionValue<>> widen(const CheckpointHeader& h, const void* payload, size_t length) {
+    QuantizedValue<Format> quantized(h.tilings, h.hashSize);
+    if (not quantized.read(payload, length))
+        return nullptr;
+    auto Q = std::make_unique<ActionValue<>>(h.tilings, h.hashSize);
+    quantized.toFloat(Q->data());
+    return Q;
+}
+
+// Returns a Checkpoint with a null agent if the file is missing, truncated or from an incompatible
+// build
+Checkpoint loadCheckpoint(const std::string& path) {
+    Checkpoint out;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open checkpoint %s\n", path.c_str());
+        return out;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 or size_t(st.st_size) < sizeof(CheckpointHeader)) {
+        fprintf(stderr, "Checkpoint %s is truncated\n", path.c_str());
+        close(fd);
+        return out;
+    }
+    size_t length = st.st_size;
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to map checkpoint %s\n", path.c_str());
+        return out;
+    }
+
+    CheckpointHeader h;
+    std::memcpy(&h, base, sizeof(h));
+    const char* problem = nullptr;
+    if (std::memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0)
+        problem = "not a checkpoint";
+    else if (h.version != CHECKPOINT_VERSION and h.version != 2)
+        problem = "unsupported version";
+    else if (h.format > static_cast<uint16_t>(WeightFormat::i8))
+        problem = "unknown weight format";
+    else if (h.angularBuckets != ANGULAR_BUCKETS or h.velocityBuckets != VELOCITY_BUCKETS or h.numActions != NUM_ACTIONS)
+        problem = "built with different bucket counts";
+    else if (h.tilings < 1 or h.tilings > MAX_TILINGS or ActionValue<>::tableSize(h.tilings, h.hashSize) != h.weights)
+        problem = "inconsistent tiling";
+    else if (length < sizeof(h) + payloadBytes(h))
+        problem = "truncated";
+    if (problem) {
+        fprintf(stderr, "Checkpoint %s: %s\n", path.c_str(), problem);
+        munmap(base, length);
+        return out;
+    }
+
+    char* payload = static_cast<char*>(base) + sizeof(h);
+    std::unique_ptr<ActionValue<>> Q;
+    switch (static_cast<WeightFormat>(h.format)) {
+    case WeightFormat::f16:
+        Q = widen<WeightFormat::f16>(h, payload, length - sizeof(h));
+        munmap(base, length);
+        break;
+    case WeightFormat::i8:
+        Q = widen<WeightFormat::i8>(h, payload, length - sizeof(h));
+        munmap(base, length);
+        break;
+    default:
+        Q = std::make_unique<ActionValue<>>(h.tilings, h.hashSize, reinterpret_cast<float*>(payload),
+                                            [base, length](float*) { munmap(base, length); });
+    }
+    out.agent = std::make_unique<Agent>(h.alpha, h.gamma, std::move(Q));
+    out.epsC = h.epsC;
+    out.step = h.step;
+    return out;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Sparse eligibility traces for SARSA(lambda) and Watkins Q(lambda).  Only weights visited
+// recently have a trace: each step every trace decays by gamma * lambda and is dropped once it
+// falls below MIN_TRACE, so the number of live traces stays small and the cost of an update depends
+// on it rather than on the size of the table.  Storage is fixed, so updates never allocate.
+
+constexpr int MAX_TRACES = 512;
+constexpr float MIN_TRACE = 0.01;
+
+enum class TraceMode {
+    none,       // one-step SARSA
+    sarsa,      // SARSA(lambda)
+    watkins     // Watkins Q(lambda), traces cut after exploratory actions
+};
+
+class SparseTraces {
+private:
+    // Open addressing table from weight index to position in the trace list.  Slots are valid only
+    // if stamped with the current generation, so invalidating the table is a counter bump.
+    static constexpr int SLOTS = 2 * MAX_TRACES;
+
+    std::array<uint32_t, MAX_TRACES> idx;
+    std::array<float, MAX_TRACES> e;
+    int n = 0;
+
+    std::array<uint32_t, SLOTS> slotKey;
+    std::array<uint32_t, SLOTS> slotPos;
+    std::array<uint32_t, SLOTS> slotGen = {};
+    uint32_t gen = 1;
+
+    static uint32_t slot(uint32_t key) {
+        return (key * 0x9E3779B1u) >> 22;   // top log2(SLOTS) bits
+    }
+
+    void invalidate(void) {
+        if (++gen == 0) {
+            slotGen.fill(0);
+            gen = 1;
+        }
+    }
+
+    void index(uint32_t key, uint32_t pos) {
+        uint32_t s = slot(key);
+        while (slotGen[s] == gen)
+            s = (s + 1) & (SLOTS - 1);
+        slotGen[s] = gen;
+        slotKey[s] = key;
+        slotPos[s] = pos;
+    }
+
+    int find(uint32_t key) const {
+        for (uint32_t s = slot(key); slotGen[s] == gen; s = (s + 1) & (SLOTS - 1))
+            if (slotKey[s] == key)
+                return slotPos[s];
+        return -1;
+    }
+
+public:
+    static_assert(SLOTS == 1 << 10, "slot() assumes a 1024 entry table");
+
+    int size(void) const {
+        return n;
+    }
+
+    void clear(void) {
+        n = 0;
+        invalidate();
+    }
+
+    // Replacing trace: the weight at key becomes fully eligible again.  If every trace is in use
+    // the weakest one makes room.
+    void replace(uint32_t key) {
+        int pos = find(key);
+        if (pos >= 0) {
+            e[pos] = 1;
+            return;
+        }
+        if (n < MAX_TRACES) {
+            pos = n++;
+        }
+        else {
+            pos = 0;
+            for (int i = 1; i < n; i++)
+                if (e[i] < e[pos])
+                    pos = i;
+            // The evicted key's slot is left pointing here; rebuild so lookups stay correct
+            idx[pos] = key;
+            e[pos] = 1;
+            invalidate();
+            for (int i = 0; i < n; i++)
+                index(idx[i], i);
+            return;
+        }
+        idx[pos] = key;
+        e[pos] = 1;
+        index(key, pos);
+    }
+
+    // w[i] += step * e(i) for every live trace, then decays the traces, dropping those that fall
+    // below MIN_TRACE.  One pass over the live traces.
+    void apply(float* w, float step, float decay) {
+        invalidate();
+        int kept = 0;
+        for (int i = 0; i < n; i++) {
+            w[ idx[i] ] += step * e[i];
+            float next = e[i] * decay;
+            if (next >= MIN_TRACE) {
+                idx[kept] = idx[i];
+                e[kept] = next;
+                index(idx[kept], kept);
+                kept++;
+            }
+        }
+        n = kept;
+    }
+};
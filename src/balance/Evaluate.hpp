@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Parallel.hpp"
+
+// Parallel greedy evaluation of a frozen policy.  Episodes are the same evaluateEpisode() rollouts
+// evaluatePolicy() runs, episode i from the seed seed + i, so the starts don't depend on which
+// thread runs the episode.  Each outcome is written to its own slot and the totals are summed in
+// episode order afterwards, so a seed gives bit-identical results on any number of threads, and
+// the same as evaluatePolicy() on one.  digest hashes every outcome, which makes that cheap to check.
+//
+// A policy is judged on whether it holds the pendulum upright, not on whether it avoids breaking:
+// hanging still never breaks.  balanced counts the episodes with an unbroken upright stretch of at
+// least balanceSeconds, and upright is the share of all decisions spent upright.
+//
+// The policy is shared read-only by the workers: it mustn't be trained while it is evaluated.
+
+// Time-to-break histogram bins: bin b counts breaks after 2^b to 2^(b+1) - 1 decisions
+constexpr int BREAK_HISTOGRAM_BINS = 32;
+
+struct EvaluationConfig {
+    size_t episodes = 1000;
+    size_t maxSteps = 1000;
+    uint64_t seed = EVAL_SEED;
+    int threads = 0;    // 0 for every core
+    double balanceSeconds = BALANCE_SECONDS;
+};
+
+struct Evaluation {
+    size_t episodes = 0;
+    size_t maxSteps = 0;
+    double balanceSeconds = 0;
+    double meanLength = 0;
+    double meanReturn = 0;
+    double balanced = 0;        // fraction of episodes upright for balanceSeconds in a row
+    double upright = 0;         // fraction of the maxSteps decisions per episode spent upright
+    double meanLongestUpright = 0;  // seconds
+    double unbroken = 0;        // fraction of episodes that never broke
+    // Seconds until the pendulum broke, over the episodes that did
+    size_t breaks = 0;
+    double breakMin = 0, breakP10 = 0, breakMedian = 0, breakP90 = 0, breakMax = 0;
+    size_t breakHistogram[BREAK_HISTOGRAM_BINS] = {};
+    uint64_t digest = 0;
+};
+
+// FNV-1a over the outcomes, in episode order
+inline uint64_t digestOutcomes(const std::vector<EpisodeOutcome>& outcomes) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&](uint64_t v) {
+        for (int i = 0; i < 8; i++, v >>= 8)
+            h = (h ^ (v & 0xff)) * 0x100000001b3ull;
+    };
+    for (const EpisodeOutcome& o : outcomes) {
+        uint64_t bits;
+        std::memcpy(&bits, &o.ret, sizeof bits);
+        mix(o.decisions | uint64_t(o.broken) << 32);
+        mix(o.upright.total | uint64_t(o.upright.longest) << 32);
+        mix(bits);
+    }
+    return h;
+}
+
+inline Evaluation summarize(const std::vector<EpisodeOutcome>& outcomes, size_t maxSteps, double balanceSeconds) {
+    Evaluation e;
+    e.episodes = outcomes.size();
+    e.maxSteps = maxSteps;
+    e.balanceSeconds = balanceSeconds;
+    std::vector<uint32_t> breakSteps;
+    for (const EpisodeOutcome& o : outcomes) {
+        e.meanLength += o.decisions;
+        e.meanReturn += o.ret;
+        e.balanced += o.upright.balanced(balanceSeconds);
+        e.upright += double(o.upright.total) / std::max<size_t>(maxSteps, 1);
+        e.meanLongestUpright += o.upright.longest * TIME_BETWEEN_ACTIONS;
+        e.unbroken += not o.broken;
+        if (o.broken) {
+            breakSteps.push_back(o.decisions);
+            e.breakHistogram[std::max(0, std::ilogb(double(o.decisions)))]++;
+        }
+    }
+    if (e.episodes) {
+        e.meanLength /= e.episodes;
+        e.meanReturn /= e.episodes;
+        e.balanced /= e.episodes;
+        e.upright /= e.episodes;
+        e.meanLongestUpright /= e.episodes;
+        e.unbroken /= e.episodes;
+    }
+    e.breaks = breakSteps.size();
+    if (e.breaks) {
+        std::sort(breakSteps.begin(), breakSteps.end());
+        auto at = [&](double q) { return breakSteps[size_t(q * (e.breaks - 1) + 0.5)] * TIME_BETWEEN_ACTIONS; };
+        e.breakMin = at(0);
+        e.breakP10 = at(0.1);
+        e.breakMedian = at(0.5);
+        e.breakP90 = at(0.9);
+        e.breakMax = at(1);
+    }
+    e.digest = digestOutcomes(outcomes);
+    return e;
+}
+
+// Anything with a const greedy(state) method can be evaluated; for an Agent pass agent.values().
+// Each worker gets its own copy of advance.
+template<typename P, typename Dynamics = ExactDynamics>
+Evaluation evaluateParallel(const P& policy, const EvaluationConfig& config, const Dynamics& advance = Dynamics()) {
+    std::vector<EpisodeOutcome> outcomes(config.episodes);
+    int threads = config.threads > 0 ? config.threads : defaultThreads();
+    parallelFor(threads, config.episodes, [&](int, size_t begin, size_t end) {
+        Dynamics local = advance;
+        for (size_t i = begin; i < end; i++)
+            outcomes[i] = evaluateEpisode(policy, config.seed + i, config.maxSteps, local);
+    });
+    return summarize(outcomes, config.maxSteps, config.balanceSeconds);
+}
+
+inline void printEvaluation(std::ostream& out, const Evaluation& e) {
+    out << "Evaluation episodes: " << e.episodes << " of up to " << e.maxSteps << " decisions\n"
+        << "Greedy mean length: " << e.meanLength << "\n"
+        << "Greedy mean return: " << e.meanReturn << "\n"
+        << "Greedy balanced fraction (upright " << e.balanceSeconds << " s): " << e.balanced << "\n"
+        << "Greedy upright fraction: " << e.upright << "\n"
+        << "Greedy mean longest upright (s): " << e.meanLongestUpright << "\n"
+        << "Greedy unbroken fraction: " << e.unbroken << "\n"
+        << "Time to break (s) over " << e.breaks << " breaks: min " << e.breakMin << ", p10 " << e.breakP10
+        << ", median " << e.breakMedian << ", p90 " << e.breakP90 << ", max " << e.breakMax << "\n"
+        << "Time to break histogram (s):";
+    for (int b = 0; b < BREAK_HISTOGRAM_BINS and (size_t(1) << b) <= e.maxSteps; b++)
+        out << " [" << (1u << b) * TIME_BETWEEN_ACTIONS << ", " << (2u << b) * TIME_BETWEEN_ACTIONS << ") " << e.breakHistogram[b];
+    out << "\nOutcome digest: " << std::hex << e.digest << std::dec << "\n";
+}
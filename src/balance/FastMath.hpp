@@ -0,0 +1,142 @@
+#pragma once
+#include <cmath>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// Polynomial sine and cosine, and branch-free angle wrapping, in scalar and AVX versions that
+// evaluate the same expression lane for lane.  The batched simulator always uses them; building
+// with -DBALANCE_FAST_MATH (make FAST_MATH=1) makes State.hpp's angle(), angle2pi() and update()
+// use them too, and keeps theta wrapped to [-pi, pi) as it is integrated.  make math-check
+// measures both paths against each other.
+//
+// sin: the argument is reduced to r = x - k*pi with |r| <= pi/2 using a two-part pi, and sin(r) is
+// r + r^3 P(r^2), P the degree 6 minimax polynomial for relative error on [0, pi/2] (Remez,
+// in long double).  Its relative error is below 2.9e-16 before rounding; evaluated in double the
+// result is within 4 ulp of the correctly rounded sine for |x| <= 4 pi.  The reduction loses about
+// |k| * 1.2e-16 absolute, so the error grows with |x|: an unwrapped angle of 1e6 costs ~4e-11,
+// which is why the fast physics keeps theta wrapped.  cos uses the same polynomial on
+// r = x - (k + 1/2) pi.
+//
+// Wrapping: wrapAngle() subtracts the nearest multiple of 2 pi, again with a two-part constant,
+// and is within |k| * 2.5e-16 of the exact remainder that fmod computes.  Near the ends of the
+// range it may return a value up to that much outside [-pi, pi].
+
+constexpr double SIN_INV_PI = 0.318309886183790671538;
+constexpr double SIN_PI_HI  = 3.14159265358979311600;
+constexpr double SIN_PI_LO  = 1.22464679914735317723e-16;
+constexpr double INV_TWO_PI = 0.159154943091895335769;
+constexpr double TWO_PI_HI  = 6.28318530717958623200;
+constexpr double TWO_PI_LO  = 2.44929359829470635445e-16;
+
+constexpr double SIN_C3  = -1.666666666666640677302e-01;
+constexpr double SIN_C5  =  8.333333333298566113396e-03;
+constexpr double SIN_C7  = -1.984126982759883977293e-04;
+constexpr double SIN_C9  =  2.755731682343411246658e-06;
+constexpr double SIN_C11 = -2.505188970245928133517e-08;
+constexpr double SIN_C13 =  1.604827448552499718323e-10;
+constexpr double SIN_C15 = -7.374417566509463712760e-13;
+
+// sin(r) for |r| <= pi/2, negated when k is odd
+inline double sinReduced(double r, double k) {
+    // (-1)^k without leaving floating point: 1 for even k, -1 for odd k
+    double half = k * 0.5;
+    double sign = 1 - 4 * (half - std::floor(half));
+
+    double r2 = r * r;
+    double p = SIN_C15;
+    p = p * r2 + SIN_C13;
+    p = p * r2 + SIN_C11;
+    p = p * r2 + SIN_C9;
+    p = p * r2 + SIN_C7;
+    p = p * r2 + SIN_C5;
+    p = p * r2 + SIN_C3;
+    return sign * (r + r * r2 * p);
+}
+
+inline double fastSin(double x) {
+    double k = std::nearbyint(x * SIN_INV_PI);
+    double r = (x - k * SIN_PI_HI) - k * SIN_PI_LO;
+    return sinReduced(r, k);
+}
+
+// cos(x) = -sin(x - pi/2) = (-1)^(k+1) sin(x - (k + 1/2) pi)
+inline double fastCos(double x) {
+    double k = std::nearbyint(x * SIN_INV_PI - 0.5);
+    double r = (x - (k + 0.5) * SIN_PI_HI) - (k + 0.5) * SIN_PI_LO;
+    return sinReduced(r, k + 1);
+}
+
+// x in [-pi, pi], for any x
+inline double wrapAngle(double x) {
+    double k = std::nearbyint(x * INV_TWO_PI);
+    return (x - k * TWO_PI_HI) - k * TWO_PI_LO;
+}
+
+// x in [0, 2 pi), for any x
+inline double wrap2pi(double x) {
+    double k = std::floor(x * INV_TWO_PI);
+    double r = (x - k * TWO_PI_HI) - k * TWO_PI_LO;
+    // x just below a multiple of 2 pi can round to the multiple above it
+    return r + TWO_PI_HI * (r < 0);
+}
+
+// One step of incremental wrapping: x in [-pi, pi) if it was at most 2 pi outside.  Integrating
+// theta moves it far less than that per step, so this keeps it wrapped for one compare and
+// subtract where wrapAngle() needs a multiply and a rounding.
+inline double rewrap(double x) {
+    return x - TWO_PI_HI * (int(x >= M_PI) - int(x < -M_PI));
+}
+
+#ifdef __AVX__
+inline __m256d sinReduced(__m256d r, __m256d k) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d half = _mm256_mul_pd(k, _mm256_set1_pd(0.5));
+    __m256d sign = _mm256_sub_pd(one, _mm256_mul_pd(_mm256_set1_pd(4.0), _mm256_sub_pd(half, _mm256_floor_pd(half))));
+
+    __m256d r2 = _mm256_mul_pd(r, r);
+    __m256d p = _mm256_set1_pd(SIN_C15);
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), _mm256_set1_pd(SIN_C13));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), _mm256_set1_pd(SIN_C11));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), _mm256_set1_pd(SIN_C9));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), _mm256_set1_pd(SIN_C7));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), _mm256_set1_pd(SIN_C5));
+    p = _mm256_add_pd(_mm256_mul_pd(p, r2), _mm256_set1_pd(SIN_C3));
+    return _mm256_mul_pd(sign, _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, r2), p)));
+}
+
+// x - k * (hi + lo), in two steps
+inline __m256d reduce(__m256d x, __m256d k, double hi, double lo) {
+    return _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(hi))), _mm256_mul_pd(k, _mm256_set1_pd(lo)));
+}
+
+inline __m256d fastSin(__m256d x) {
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(SIN_INV_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    return sinReduced(reduce(x, k, SIN_PI_HI, SIN_PI_LO), k);
+}
+
+inline __m256d fastCos(__m256d x) {
+    const __m256d half = _mm256_set1_pd(0.5);
+    __m256d k = _mm256_round_pd(_mm256_sub_pd(_mm256_mul_pd(x, _mm256_set1_pd(SIN_INV_PI)), half), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    return sinReduced(reduce(x, _mm256_add_pd(k, half), SIN_PI_HI, SIN_PI_LO), _mm256_add_pd(k, _mm256_set1_pd(1.0)));
+}
+
+inline __m256d wrapAngle(__m256d x) {
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(INV_TWO_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    return reduce(x, k, TWO_PI_HI, TWO_PI_LO);
+}
+
+inline __m256d wrap2pi(__m256d x) {
+    __m256d k = _mm256_floor_pd(_mm256_mul_pd(x, _mm256_set1_pd(INV_TWO_PI)));
+    __m256d r = reduce(x, k, TWO_PI_HI, TWO_PI_LO);
+    __m256d negative = _mm256_cmp_pd(r, _mm256_setzero_pd(), _CMP_LT_OQ);
+    return _mm256_add_pd(r, _mm256_and_pd(negative, _mm256_set1_pd(TWO_PI_HI)));
+}
+
+inline __m256d rewrap(__m256d x) {
+    const __m256d twoPi = _mm256_set1_pd(TWO_PI_HI);
+    __m256d over = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(M_PI), _CMP_GE_OQ), twoPi);
+    __m256d under = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(-M_PI), _CMP_LT_OQ), twoPi);
+    return _mm256_add_pd(_mm256_sub_pd(x, over), under);
+}
+#endif
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Telemetry.hpp"
+
+// Hogwild-style parallel SARSA: every worker thread runs its own pendulum episodes and writes TD
+// updates straight into one shared ActionValue with no locking.  Weights are read and written with
+// relaxed atomic operations, so a concurrent update to the same weight can be lost but never torn,
+// which the table tolerates because collisions are rare and SARSA is self-correcting.
+
+float loadRelaxed(const float* p) {
+    float out;
+    __atomic_load(p, &out, __ATOMIC_RELAXED);
+    return out;
+}
+
+void storeRelaxed(float* p, float value) {
+    __atomic_store(p, &value, __ATOMIC_RELAXED);
+}
+
+// One worker's view of the shared table.  Exploration draws from the worker thread's own generator,
+// which is reseeded when the agent is made.
+class HogwildAgent {
+private:
+    ActionValue<>& Q;
+    float alpha;
+    float gamma;
+    float delta = 0;
+
+    float value(const Features& f, Action a) {
+        float q = 0;
+        for (int t = 0; t < f.count; t++)
+            q += loadRelaxed(Q.data() + Q.index(f.idx[t], a));
+        return q;
+    }
+
+    ActionValue<>::Values values(const Features& f) {
+        ActionValue<>::Values out = {};
+        for (int t = 0; t < f.count; t++) {
+            const float* cell = Q.data() + Q.index(f.idx[t], Action::off);
+            for (int k = 0; k < ActionValue<>::STRIDE; k++)
+                out.q[k] += loadRelaxed(cell + k);
+        }
+        return out;
+    }
+
+public:
+    HogwildAgent(ActionValue<>& Q, float alpha, float gamma, uint64_t seed): Q(Q), alpha(alpha), gamma(gamma) {
+        seedThread(seed);
+    }
+
+    void beginEpisode(void) {}
+
+    // Same policy as ActionValue::greedy, ties going to the first action
+    Action greedy(const State& x, double eps = 1) {
+        if (uniform() < eps) {
+            Features f;
+            Q.active(x, f);
+            return ActionValue<>::argmax(values(f));
+        }
+        else {
+            return Environment::actions[ uniformInt(0, Environment::actions.size()) ];
+        }
+    }
+
+    void updateSarsa(const State& cur, Action curAct, double reward, const State& prev, Action prevAct) {
+        Features f, next;
+        Q.active(prev, f);
+        Q.active(cur, next);
+        double target = cur.broken ? reward : reward + gamma * value(next, curAct);
+        delta = target - value(f, prevAct);
+        float step = alpha * delta / f.count;
+        for (int t = 0; t < f.count; t++) {
+            float* w = Q.data() + Q.index(f.idx[t], prevAct);
+            storeRelaxed(w, loadRelaxed(w) + step);
+        }
+    }
+
+    float tdError(void) const {
+        return delta;
+    }
+};
+
+struct HogwildStats {
+    size_t episodes = 0;
+    size_t decisions = 0;
+    size_t broken = 0;
+    double ret = 0;
+    double seconds = 0;
+};
+
+// Trains Q with the given number of threads, splitting the episode budget between them.  Each
+// worker keeps its own exploration schedule, starting at startStep (the step of a loaded checkpoint),
+// and seeds its thread's generator with seed + worker index.
+HogwildStats trainHogwild(ActionValue<>& Q, int threads, size_t episodes, size_t maxSteps,
+                          float alpha, float gamma, double epsC, uint64_t seed, size_t startStep = 0,
+                          TrainingMetrics* metrics = nullptr) {
+    // Per-worker totals, padded so workers don't share cache lines while counting
+    struct alignas(64) WorkerStats {
+        HogwildStats stats;
+    };
+    std::vector<WorkerStats> results(threads);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        size_t share = episodes / threads + (size_t(t) < episodes % threads ? 1 : 0);
+        workers.emplace_back([&, t, share] {
+            HogwildAgent agent(Q, alpha, gamma, seed + t);
+            HogwildStats& out = results[t].stats;
+            TrainingProbe probe(metrics);
+            auto observe = [&](const State&, Action, double, const State&) { probe.action(agent.tdError()); };
+            size_t step = startStep;
+            for (size_t ep = 0; ep < share; ep++) {
+                auto stats = runEpisode(agent, randomState(), maxSteps, step, epsC, observe);
+                probe.episode(stats.decisions, stats.ret, stats.broken);
+                out.episodes++;
+                out.ret += stats.ret;
+                out.broken += stats.broken;
+            }
+            out.decisions = step - startStep;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    HogwildStats total;
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& r : results) {
+        total.episodes += r.stats.episodes;
+        total.decisions += r.stats.decisions;
+        total.broken += r.stats.broken;
+        total.ret += r.stats.ret;
+    }
+    return total;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small helpers for splitting work across cores
+
+// Number of worker threads to use when the caller asks for 0
+int defaultThreads(void) {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Number of chunks parallelFor(threads, n, f) actually runs: at least one, at most one per item
+inline int parallelWorkers(int threads, size_t n) {
+    return std::max(1, std::min<int>(threads, std::max<size_t>(n, 1)));
+}
+
+// Calls f(thread, begin, end) on each of threads contiguous chunks of [0, n) in parallel
+template<typename F>
+void parallelFor(int threads, size_t n, F f) {
+    threads = parallelWorkers(threads, n);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = n * t / threads;
+        size_t end = n * (t + 1) / threads;
+        if (t == threads - 1)
+            f(t, begin, end);   // the calling thread takes the last chunk
+        else
+            workers.emplace_back(f, t, begin, end);
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+// Calls f(thread, i) for every i in [0, n), handing indices out one at a time so long jobs don't
+// hold up a whole chunk
+template<typename F>
+void parallelJobs(int threads, size_t n, F f) {
+    std::atomic<size_t> next{0};
+    parallelFor(threads, std::min<size_t>(threads, n), [&](int t, size_t, size_t) {
+        for (size_t i = next++; i < n; i = next++)
+            f(t, i);
+    });
+}
+
+// Reusable barrier for a fixed number of threads
+class Barrier {
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    int threads;
+    int waiting = 0;
+    size_t generation = 0;
+
+public:
+    Barrier(int threads): threads(threads) {}
+
+    void wait(void) {
+        std::unique_lock<std::mutex> lock(m);
+        size_t gen = generation;
+        if (++waiting == threads) {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+        }
+        else {
+            cv.wait(lock, [&] { return gen != generation; });
+        }
+    }
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+#include "Telemetry.hpp"
+
+// Actor-learner training.  Actor threads run pendulum episodes with a read-only snapshot of the
+// weights and stream their transitions through one SPSC queue each to a single learner thread,
+// which applies the SARSA updates to the real table.  Every publishEvery updates the learner copies
+// its weights into each actor's triple buffer and publishes them, so simulation and learning
+// overlap instead of taking turns.  The snapshots are allocated up front, three per actor, so
+// publishing costs a table copy per actor but never allocates.
+//
+// The learner sees the actors' transitions interleaved, so it can't keep eligibility traces: the
+// agent must not have any set.
+
+constexpr size_t PIPELINE_QUEUE_SIZE = 4096;
+
+struct TransitionMsg {
+    State prev;
+    Action action;
+    Action nextAction;
+    float reward;
+    State next;
+    uint64_t snapshotUpdates;   // learner updates already in the weights the actor acted with
+};
+
+struct PipelineStats {
+    size_t episodes = 0;
+    size_t decisions = 0;
+    size_t broken = 0;
+    double ret = 0;
+    double seconds = 0;
+    size_t snapshots = 0;
+    double meanQueueFill = 0;   // fraction of capacity, sampled every time the learner polls
+    double maxQueueFill = 0;
+    size_t fullWaits = 0;       // times an actor found its queue full and had to wait
+    double meanLag = 0;         // learner updates not yet in the actor's snapshot
+    size_t maxLag = 0;
+};
+
+// Weights the actors act on, tagged with how many updates they contain
+struct Snapshot {
+    ActionValue<> Q;
+    uint64_t updates = 0;
+
+    Snapshot(int tilings, size_t hashSize): Q(tilings, hashSize) {}
+};
+
+// Each actor's exploration schedule starts at startStep, the step of a loaded checkpoint
+PipelineStats trainPipelined(Agent& agent, int actors, size_t episodes, size_t maxSteps,
+                             double epsC, uint64_t seed, size_t startStep = 0, size_t publishEvery = 1000,
+                             TrainingMetrics* metrics = nullptr) {
+    std::vector<std::unique_ptr<SpscQueue<TransitionMsg>>> queues;
+    for (int a = 0; a < actors; a++)
+        queues.push_back(std::make_unique<SpscQueue<TransitionMsg>>(PIPELINE_QUEUE_SIZE));
+
+    const ActionValue<>& W = agent.values();
+    std::vector<std::unique_ptr<TripleBuffer<Snapshot>>> snapshots;
+    for (int a = 0; a < actors; a++)
+        snapshots.push_back(std::make_unique<TripleBuffer<Snapshot>>(std::in_place, W.coder().numTilings(), W.coder().hashSize()));
+    auto publish = [&](uint64_t updates) {
+        for (auto& buffer : snapshots) {
+            Snapshot& s = buffer->write();
+            s.Q.copyFrom(W);
+            s.updates = updates;
+            buffer->publish();
+        }
+    };
+    publish(0);
+    std::atomic<int> running{actors};
+
+    struct alignas(64) ActorStats {
+        PipelineStats stats;
+    };
+    std::vector<ActorStats> actorStats(actors);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int id = 0; id < actors; id++) {
+        size_t share = episodes / actors + (size_t(id) < episodes % actors ? 1 : 0);
+        threads.emplace_back([&, id, share] {
+            seedThread(seed + id);
+            SpscQueue<TransitionMsg>& queue = *queues[id];
+            PipelineStats& out = actorStats[id].stats;
+            TrainingProbe probe(metrics);
+            TripleBuffer<Snapshot>& snapshot = *snapshots[id];
+            const Snapshot* snap = &snapshot.read();
+            size_t step = startStep;
+
+            for (size_t ep = 0; ep < share; ep++) {
+                size_t length = 0;
+                double ret = 0;
+                State x = randomState();
+                Action a = snap->Q.greedy(x, epsilon(step, epsC));
+
+                for (size_t n = 0; n < maxSteps; n++) {
+                    // Pick up a newer snapshot between actions if one was published
+                    snap = &snapshot.read();
+                    TransitionMsg msg;
+                    msg.prev = x;
+                    msg.action = a;
+                    act(x, a);
+                    ExactDynamics()(x);
+                    step++;
+                    msg.reward = Environment::reward(msg.prev, a, x);
+                    msg.next = x;
+                    msg.nextAction = snap->Q.greedy(x, epsilon(step, epsC));
+                    msg.snapshotUpdates = snap->updates;
+                    while (not queue.push(msg)) {
+                        out.fullWaits++;
+                        std::this_thread::yield();
+                    }
+                    length++;
+                    ret += msg.reward;
+                    a = msg.nextAction;
+                    if (x.broken)
+                        break;
+                }
+                out.episodes++;
+                out.broken += x.broken;
+                out.ret += ret;
+                probe.episode(length, ret, x.broken);
+            }
+            out.decisions = step - startStep;
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // The learner runs on the calling thread
+    TrainingProbe probe(metrics);
+    PipelineStats total;
+    uint64_t updates = 0;
+    double lagSum = 0;
+    double fillSum = 0;
+    size_t polls = 0;
+    while (true) {
+        bool finished = running.load(std::memory_order_acquire) == 0;
+        size_t drained = 0;
+        for (auto& q : queues) {
+            double fill = double(q->size()) / q->capacity();
+            fillSum += fill;
+            total.maxQueueFill = std::max(total.maxQueueFill, fill);
+            polls++;
+
+            TransitionMsg msg;
+            while (q->pop(msg)) {
+                agent.updateSarsa(msg.next, msg.nextAction, msg.reward, msg.prev, msg.action);
+                probe.action(agent.tdError());
+                size_t lag = updates - msg.snapshotUpdates;
+                lagSum += lag;
+                total.maxLag = std::max(total.maxLag, lag);
+                updates++;
+                drained++;
+                if (updates % publishEvery == 0) {
+                    publish(updates);
+                    total.snapshots++;
+                }
+            }
+        }
+        // Actors only stop after their last push, so one more empty pass after they've all
+        // finished means everything has been learned from
+        if (finished and drained == 0)
+            break;
+        if (drained == 0)
+            std::this_thread::yield();
+    }
+    for (auto& t : threads)
+        t.join();
+
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& a : actorStats) {
+        total.episodes += a.stats.episodes;
+        total.decisions += a.stats.decisions;
+        total.broken += a.stats.broken;
+        total.ret += a.stats.ret;
+        total.fullWaits += a.stats.fullWaits;
+    }
+    total.meanQueueFill = polls ? fillSum / polls : 0;
+    total.meanLag = updates ? lagSum / updates : 0;
+    return total;
+}
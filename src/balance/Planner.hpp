@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "State.hpp"
+#include "BatchEnv.hpp"
+#include "Parallel.hpp"
+
+// Model-based planning over the base tile grid.  The physics and reward are known, so instead of
+// sampling transitions we simulate one action interval from the centre of every cell for every
+// action, then solve the resulting deterministic MDP with synchronous value iteration.
+//
+// The model treats each action as setting the torques outright (off clears both, torqueL and
+// torqueR switch on one side only), since the cell doesn't record which torques were left on.
+// Cells are the tiles of a one-tiling TileCoder, including the edge row that catches momenta past
+// MAX_VELOCITY, so the planned table can be used directly as an ActionValue with one tiling.
+class Planner {
+public:
+    using Coder = ActionValue<>::Coder;
+
+private:
+    float gamma;
+    int threads;
+    Coder cells;
+
+    // Structure-of-arrays model, indexed [action * cells + cell]
+    std::vector<uint32_t> next;
+    std::vector<float> reward;
+    std::vector<float> discount;    // gamma, or 0 when the transition ends the episode
+    std::vector<float> V;
+
+    static constexpr int VELOCITY_TILES = VELOCITY_BUCKETS + 1;
+
+    State centre(size_t cell) const {
+        size_t i = cell % ANGULAR_BUCKETS;
+        size_t j = cell / ANGULAR_BUCKETS;
+        return State{(i + 0.5) * 2 * M_PI / ANGULAR_BUCKETS,
+                     MIN_VELOCITY + (j + 0.5) * (MAX_VELOCITY - MIN_VELOCITY) / VELOCITY_BUCKETS,
+                     false, false, false};
+    }
+
+    float backup(size_t cell, int a, const float* v) const {
+        size_t k = a * cells.size() + cell;
+        return reward[k] + discount[k] * v[ next[k] ];
+    }
+
+public:
+    // threads of 0 uses every core
+    Planner(float gamma, int threads = 0):
+        gamma(gamma),
+        threads(threads > 0 ? threads : defaultThreads()),
+        cells(1),
+        V(cells.size(), 0) {}
+
+    size_t size(void) const {
+        return cells.size();
+    }
+
+    // Simulates PHYSICS_STEPS_PER_ACTION substeps from every (cell, action), each thread stepping its
+    // share of the cells as one batch
+    void buildModel(void) {
+        size_t n = cells.size();
+        next.resize(n * NUM_ACTIONS);
+        reward.resize(n * NUM_ACTIONS);
+        discount.resize(n * NUM_ACTIONS);
+
+        parallelFor(threads, n, [&](int, size_t begin, size_t end) {
+            size_t m = end - begin;
+            BatchEnvironment batch(m);
+            std::vector<Action> acts(m);
+            std::vector<double> r(m);
+            for (int a = 0; a < NUM_ACTIONS; a++) {
+                for (size_t c = begin; c < end; c++) {
+                    batch.set(c - begin, centre(c));
+                    acts[c - begin] = Action::off;
+                }
+                batch.act(acts.data());
+                std::fill(acts.begin(), acts.end(), static_cast<Action>(a));
+                batch.act(acts.data());
+                batch.update(PHYSICS_STEPS_PER_ACTION);
+                batch.reward(acts.data(), r.data());
+
+                Features f;
+                for (size_t c = begin; c < end; c++) {
+                    size_t k = a * n + c;
+                    cells.active(batch.get(c - begin), f);
+                    next[k] = f.idx[0];
+                    // A break is absorbing: its penalty repeats forever instead of ending the
+                    // episode, so that breaking is never cheaper than a negative reward per step
+                    bool broke = batch.broken[c - begin];
+                    reward[k] = broke ? r[c - begin] / (1 - gamma) : r[c - begin];
+                    discount[k] = broke ? 0 : gamma;
+                }
+            }
+        });
+    }
+
+    // Synchronous value iteration until no value moves by more than tolerance.  Every thread owns a
+    // fixed range of cells and the threads meet at a barrier after each sweep.  Returns the number of
+    // sweeps run.
+    int solve(double tolerance = 1e-6, int maxSweeps = 10000) {
+        size_t n = cells.size();
+        std::vector<float> Vnext(n, 0);
+        // The barrier must count the workers parallelFor really starts, or it waits forever
+        int workers = parallelWorkers(threads, n);
+        std::vector<float> deltas(workers, 0);
+        Barrier barrier(workers);
+        std::atomic<bool> done{false};
+        int sweeps = 0;
+
+        parallelFor(workers, n, [&](int t, size_t begin, size_t end) {
+            float* cur = V.data();
+            float* out = Vnext.data();
+            while (true) {
+                // Max over actions of r + discount * V[next], a branch-free loop per action that
+                // the compiler turns into vector gathers
+                for (size_t c = begin; c < end; c++)
+                    out[c] = backup(c, 0, cur);
+                for (int a = 1; a < NUM_ACTIONS; a++)
+                    for (size_t c = begin; c < end; c++)
+                        out[c] = std::max(out[c], backup(c, a, cur));
+
+                float delta = 0;
+                for (size_t c = begin; c < end; c++)
+                    delta = std::max(delta, std::abs(out[c] - cur[c]));
+                deltas[t] = delta;
+
+                barrier.wait();
+                if (t == 0) {
+                    sweeps++;
+                    float worst = *std::max_element(deltas.begin(), deltas.end());
+                    done = worst <= tolerance or sweeps >= maxSweeps;
+                }
+                barrier.wait();
+                std::swap(cur, out);
+                if (done)
+                    break;
+            }
+        });
+
+        // Each thread swapped in step, so the latest sweep is in Vnext after an odd number of sweeps
+        if (sweeps % 2 == 1)
+            V.swap(Vnext);
+        return sweeps;
+    }
+
+    double value(size_t cell) const {
+        return V[cell];
+    }
+
+    // Q(x, a) = r + discount * V(next) as a one-tiling ActionValue, ready for greedy control or
+    // further training
+    std::unique_ptr<ActionValue<>> actionValue(void) const {
+        auto Q = std::make_unique<ActionValue<>>(1);
+        for (size_t c = 0; c < cells.size(); c++)
+            for (int a = 0; a < NUM_ACTIONS; a++)
+                Q->data()[ Q->index(c, static_cast<Action>(a)) ] = backup(c, a, V.data());
+        return Q;
+    }
+};
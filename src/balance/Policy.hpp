@@ -0,0 +1,166 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "State.hpp"
+
+// Greedy policy compiled out of an ActionValue: argmax_a Q(x, a) for every cell of a grid, packed
+// 2 bits per cell.  Every tiling's boundaries fall on multiples of 1/tilings of a bucket, so on a
+// grid subdivided that finely Q is constant within each cell and the compiled policy is exactly
+// the greedy one.  Coarser grids (subdivisions of 1 is the bucket grid itself, 2.5 KB) sample Q at
+// the cell centres and trade exactness for fitting in L1.
+//
+// Lookups are branch free: the angle is wrapped with a floor instead of fmod and the velocity
+// clamped with min/max, then the cell's two bits are shifted out of their word.
+
+constexpr char POLICY_MAGIC[4] = {'R', 'M', 'L', 'P'};
+constexpr uint32_t POLICY_VERSION = 1;
+constexpr int POLICY_CELLS_PER_WORD = 32;
+
+static_assert(sizeof(Action) == sizeof(int32_t), "batched lookups store actions as 32 bit lanes");
+
+class PackedPolicy {
+private:
+    int32_t angleCells = 0;
+    int32_t velocityCells = 0;
+    double angleScale = 0;      // cells per radian
+    double velocityScale = 0;   // cells per unit of L above MIN_VELOCITY
+    std::vector<uint64_t> bits;
+
+    void set(size_t cell, Action a) {
+        bits[cell / POLICY_CELLS_PER_WORD] |= uint64_t(static_cast<int>(a)) << (2 * (cell % POLICY_CELLS_PER_WORD));
+    }
+
+public:
+    PackedPolicy(void) {}
+
+    // subdivisions of 0 compiles the exact policy, one cell per tile intersection
+    template<int AngleBins, int VelocityBins, int Actions>
+    PackedPolicy(const ActionValue<AngleBins, VelocityBins, Actions>& Q, int subdivisions = 0) {
+        static_assert(Actions <= 4, "2 bits per cell");
+        if (subdivisions <= 0)
+            subdivisions = Q.coder().numTilings();
+        // Velocity tiles cover one bucket past MAX_VELOCITY, as in TileCoder
+        angleCells = AngleBins * subdivisions;
+        velocityCells = (VelocityBins + 1) * subdivisions;
+        angleScale = angleCells / (2 * M_PI);
+        velocityScale = subdivisions * VelocityBins / (MAX_VELOCITY - MIN_VELOCITY);
+        bits.assign((size() + POLICY_CELLS_PER_WORD - 1) / POLICY_CELLS_PER_WORD, 0);
+
+        for (int32_t j = 0; j < velocityCells; j++)
+            for (int32_t i = 0; i < angleCells; i++) {
+                State x{(i + 0.5) / angleScale, MIN_VELOCITY + (j + 0.5) / velocityScale, false, false, false};
+                set(size_t(j) * angleCells + i, Q.argmax(Q.values(x)));
+            }
+    }
+
+    size_t size(void) const {
+        return size_t(angleCells) * velocityCells;
+    }
+
+    size_t bytes(void) const {
+        return bits.size() * sizeof(uint64_t);
+    }
+
+    size_t cell(double theta, double L) const {
+        double a = theta * angleScale;
+        a -= angleCells * std::floor(a * (1.0 / angleCells));
+        int32_t i = std::min(int32_t(a), angleCells - 1);
+        double v = std::min(std::max(std::floor((L - MIN_VELOCITY) * velocityScale), 0.0), velocityCells - 1.0);
+        return size_t(i) + size_t(angleCells) * size_t(v);
+    }
+
+    Action operator() (double theta, double L) const {
+        size_t c = cell(theta, L);
+        return static_cast<Action>((bits[c / POLICY_CELLS_PER_WORD] >> (2 * (c % POLICY_CELLS_PER_WORD))) & 3);
+    }
+
+    // Same interface as Agent::greedy so the policy can be evaluated and deployed in its place
+    Action greedy(const State& x, double = 1) const {
+        return (*this)(x.theta, x.L);
+    }
+
+    // Greedy actions for n states given as separate theta and L arrays, e.g. a BatchEnvironment's
+    void greedy(const double* theta, const double* L, Action* out, size_t n) const {
+        size_t k = 0;
+#ifdef __AVX2__
+        const __m256d aScale = _mm256_set1_pd(angleScale);
+        const __m256d aInv = _mm256_set1_pd(1.0 / angleCells);
+        const __m256d aCells = _mm256_set1_pd(angleCells);
+        const __m128i aLast = _mm_set1_epi32(angleCells - 1);
+        const __m256d vScale = _mm256_set1_pd(velocityScale);
+        const __m256d vMin = _mm256_set1_pd(MIN_VELOCITY);
+        const __m256d vLast = _mm256_set1_pd(velocityCells - 1.0);
+        const __m128i stride = _mm_set1_epi32(angleCells);
+        const __m256i three = _mm256_set1_epi64x(3);
+        const __m256i low32 = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+        const long long* words = reinterpret_cast<const long long*>(bits.data());
+        for (; k + 4 <= n; k += 4) {
+            __m256d a = _mm256_mul_pd(_mm256_loadu_pd(theta + k), aScale);
+            a = _mm256_sub_pd(a, _mm256_mul_pd(aCells, _mm256_floor_pd(_mm256_mul_pd(a, aInv))));
+            __m128i i = _mm_min_epi32(_mm256_cvttpd_epi32(a), aLast);
+            __m256d v = _mm256_floor_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(L + k), vMin), vScale));
+            v = _mm256_min_pd(_mm256_max_pd(v, _mm256_setzero_pd()), vLast);
+            __m128i c = _mm_add_epi32(i, _mm_mullo_epi32(_mm256_cvttpd_epi32(v), stride));
+            __m256i w = _mm256_i32gather_epi64(words, _mm_srli_epi32(c, 5), 8);
+            __m256i shift = _mm256_cvtepi32_epi64(_mm_slli_epi32(_mm_and_si128(c, _mm_set1_epi32(31)), 1));
+            __m256i act = _mm256_and_si256(_mm256_srlv_epi64(w, shift), three);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(act, low32)));
+        }
+#endif
+        for (; k < n; k++)
+            out[k] = (*this)(theta[k], L[k]);
+    }
+
+    bool save(const std::string& path) const {
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (f == nullptr) {
+            std::cerr << "Can't write " << path << std::endl;
+            return false;
+        }
+        uint32_t version = POLICY_VERSION;
+        bool ok = std::fwrite(POLICY_MAGIC, 1, 4, f) == 4
+              and std::fwrite(&version, sizeof version, 1, f) == 1
+              and std::fwrite(&angleCells, sizeof angleCells, 1, f) == 1
+              and std::fwrite(&velocityCells, sizeof velocityCells, 1, f) == 1
+              and std::fwrite(&angleScale, sizeof angleScale, 1, f) == 1
+              and std::fwrite(&velocityScale, sizeof velocityScale, 1, f) == 1
+              and std::fwrite(bits.data(), sizeof(uint64_t), bits.size(), f) == bits.size();
+        ok = std::fclose(f) == 0 and ok;
+        if (not ok)
+            std::cerr << "Failed writing " << path << std::endl;
+        return ok;
+    }
+
+    bool load(const std::string& path) {
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (f == nullptr) {
+            std::cerr << "Can't open " << path << std::endl;
+            return false;
+        }
+        char magic[4];
+        uint32_t version = 0;
+        bool ok = std::fread(magic, 1, 4, f) == 4 and std::memcmp(magic, POLICY_MAGIC, 4) == 0
+              and std::fread(&version, sizeof version, 1, f) == 1 and version == POLICY_VERSION
+              and std::fread(&angleCells, sizeof angleCells, 1, f) == 1
+              and std::fread(&velocityCells, sizeof velocityCells, 1, f) == 1
+              and std::fread(&angleScale, sizeof angleScale, 1, f) == 1
+              and std::fread(&velocityScale, sizeof velocityScale, 1, f) == 1
+              and angleCells > 0 and velocityCells > 0;
+        if (ok) {
+            bits.assign((size() + POLICY_CELLS_PER_WORD - 1) / POLICY_CELLS_PER_WORD, 0);
+            ok = std::fread(bits.data(), sizeof(uint64_t), bits.size(), f) == bits.size();
+        }
+        std::fclose(f);
+        if (not ok)
+            std::cerr << path << " is not a version " << POLICY_VERSION << " policy file" << std::endl;
+        return ok;
+    }
+};
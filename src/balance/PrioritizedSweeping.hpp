@@ -0,0 +1,254 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "State.hpp"
+
+// Prioritized sweeping on a tabular action-value function: a one-tiling, unhashed ActionValue, whose
+// features are the cells of the base grid (the same table Planner produces).  Every real transition
+// updates a learned model of (cell, action) -> (next cell, reward) and queues the pair by its Bellman
+// error.  Planning then backs up the pairs with the largest errors first.  After each backup, the
+// predecessors of the changed cell are requeued by their own errors, so the new value spreads
+// backwards through the model.  Each physics rollout feeds many backups this way.
+//
+// The cells are coarser than the state, so a (cell, action) pair leads to different cells depending
+// on where in the cell, and with which torques on, it was taken.  The model keeps up to
+// SUCCESSOR_SLOTS successors per pair with their visit counts and mean rewards, and backs up the
+// expectation over them.  A new successor replaces the least visited one once the slots are full.
+// Each cell remembers up to PREDECESSOR_SLOTS predecessor pairs, overwriting the oldest once full.
+//
+// The model, the predecessor lists and the queue are all sized for every pair up front, so nothing
+// allocates after construction.
+
+constexpr int SUCCESSOR_SLOTS = 4;
+constexpr int PREDECESSOR_SLOTS = 16;
+// Bellman errors at or below this aren't queued
+constexpr float SWEEP_THRESHOLD = 1e-3f;
+
+// Max-heap of keys in [0, n) by priority, with each key's position kept so a queued key's priority
+// can be raised in place
+class IndexedHeap {
+private:
+    std::vector<uint32_t> heap;
+    std::vector<float> priority;    // by key
+    std::vector<int32_t> slot;      // by key: position in heap, or -1 if not queued
+    size_t count = 0;
+
+    void place(size_t i, uint32_t key) {
+        heap[i] = key;
+        slot[key] = int32_t(i);
+    }
+
+    void siftUp(size_t i) {
+        uint32_t key = heap[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (priority[heap[parent]] >= priority[key])
+                break;
+            place(i, heap[parent]);
+            i = parent;
+        }
+        place(i, key);
+    }
+
+    void siftDown(size_t i) {
+        uint32_t key = heap[i];
+        while (true) {
+            size_t child = 2 * i + 1;
+            if (child >= count)
+                break;
+            if (child + 1 < count and priority[heap[child + 1]] > priority[heap[child]])
+                child++;
+            if (priority[heap[child]] <= priority[key])
+                break;
+            place(i, heap[child]);
+            i = child;
+        }
+        place(i, key);
+    }
+
+public:
+    IndexedHeap(size_t keys): heap(keys), priority(keys, 0), slot(keys, -1) {}
+
+    size_t size(void) const {
+        return count;
+    }
+
+    bool empty(void) const {
+        return count == 0;
+    }
+
+    // Queues key, or raises its priority if it is queued lower.  A lower priority leaves it as it is.
+    void raise(uint32_t key, float p) {
+        if (slot[key] < 0) {
+            priority[key] = p;
+            place(count, key);
+            siftUp(count++);
+        }
+        else if (p > priority[key]) {
+            priority[key] = p;
+            siftUp(slot[key]);
+        }
+    }
+
+    uint32_t pop(void) {
+        uint32_t top = heap[0];
+        slot[top] = -1;
+        if (--count > 0) {
+            heap[0] = heap[count];
+            siftDown(0);
+        }
+        return top;
+    }
+};
+
+class PrioritizedSweeping {
+public:
+    static constexpr uint32_t NO_CELL = UINT32_MAX;
+    static constexpr uint32_t TERMINAL = UINT32_MAX - 1;
+
+private:
+    ActionValue<>& Q;
+    float gamma;
+    float threshold;
+    size_t cells;
+
+    // Model, indexed [key * SUCCESSOR_SLOTS + slot] with key = cell * NUM_ACTIONS + action
+    std::vector<uint32_t> successor;
+    std::vector<uint32_t> visits;
+    std::vector<float> reward;      // mean reward of the visits
+    // Predecessor keys, indexed [cell * PREDECESSOR_SLOTS + slot]
+    std::vector<uint32_t> predecessor;
+    std::vector<uint8_t> predecessorCount;
+    std::vector<uint8_t> predecessorNext;   // slot to overwrite once full
+    IndexedHeap queue;
+    size_t backups = 0;
+
+    uint32_t cellOf(const State& x) const {
+        Features f;
+        Q.active(x, f);
+        return f.idx[0];
+    }
+
+    float& q(uint32_t key) {
+        return Q.data()[ Q.index(key / NUM_ACTIONS, static_cast<Action>(key % NUM_ACTIONS)) ];
+    }
+
+    float maxValue(uint32_t cell) const {
+        const float* w = Q.data() + Q.index(cell, Action::off);
+        float best = w[0];
+        for (int a = 1; a < NUM_ACTIONS; a++)
+            best = std::max(best, w[a]);
+        return best;
+    }
+
+    // Expected reward plus discounted value of the successors seen so far
+    float backup(uint32_t key) const {
+        float total = 0, sum = 0;
+        for (size_t s = key * SUCCESSOR_SLOTS; s < (key + 1) * SUCCESSOR_SLOTS; s++) {
+            if (successor[s] == NO_CELL)
+                continue;
+            float v = reward[s];
+            if (successor[s] != TERMINAL)
+                v += gamma * maxValue(successor[s]);
+            total += visits[s];
+            sum += visits[s] * v;
+        }
+        return sum / total;
+    }
+
+    void addPredecessor(uint32_t cell, uint32_t key) {
+        uint32_t* p = &predecessor[cell * PREDECESSOR_SLOTS];
+        int n = predecessorCount[cell];
+        for (int k = 0; k < n; k++)
+            if (p[k] == key)
+                return;
+        if (n < PREDECESSOR_SLOTS) {
+            p[n] = key;
+            predecessorCount[cell]++;
+        }
+        else {
+            p[predecessorNext[cell]] = key;
+            predecessorNext[cell] = (predecessorNext[cell] + 1) % PREDECESSOR_SLOTS;
+        }
+    }
+
+    void prioritize(uint32_t key) {
+        float error = std::fabs(backup(key) - q(key));
+        if (error > threshold)
+            queue.raise(key, error);
+    }
+
+public:
+    // Q must have one tiling and no hashing (see supports()) and outlive the sweeper
+    PrioritizedSweeping(ActionValue<>& Q, float gamma, float threshold = SWEEP_THRESHOLD):
+        Q(Q), gamma(gamma), threshold(threshold), cells(Q.coder().size()),
+        successor(cells * NUM_ACTIONS * SUCCESSOR_SLOTS, NO_CELL),
+        visits(cells * NUM_ACTIONS * SUCCESSOR_SLOTS, 0),
+        reward(cells * NUM_ACTIONS * SUCCESSOR_SLOTS, 0),
+        predecessor(cells * PREDECESSOR_SLOTS, 0),
+        predecessorCount(cells, 0),
+        predecessorNext(cells, 0),
+        queue(cells * NUM_ACTIONS) {}
+
+    static bool supports(const ActionValue<>& Q) {
+        return Q.coder().numTilings() == 1 and Q.coder().hashSize() == 0;
+    }
+
+    // Adds a real transition to the model and queues its pair
+    void observe(const State& prev, Action a, double r, const State& next) {
+        uint32_t key = cellOf(prev) * NUM_ACTIONS + static_cast<uint32_t>(a);
+        uint32_t to = next.broken ? TERMINAL : cellOf(next);
+        size_t first = size_t(key) * SUCCESSOR_SLOTS, s = first;
+        for (size_t k = first; k < first + SUCCESSOR_SLOTS; k++) {
+            if (successor[k] == to or successor[k] == NO_CELL) {
+                s = k;
+                break;
+            }
+            if (visits[k] < visits[s])
+                s = k;
+        }
+        if (successor[s] != to) {
+            successor[s] = to;
+            visits[s] = 0;
+            reward[s] = 0;
+        }
+        visits[s]++;
+        reward[s] += (float(r) - reward[s]) / visits[s];
+        if (to != TERMINAL)
+            addPredecessor(to, key);
+        prioritize(key);
+    }
+
+    // Up to budget backups, largest Bellman error first.  Returns how many were done.
+    int plan(int budget) {
+        int n = 0;
+        for (; n < budget and not queue.empty(); n++) {
+            uint32_t key = queue.pop();
+            q(key) = backup(key);
+            uint32_t cell = key / NUM_ACTIONS;
+            const uint32_t* p = &predecessor[cell * PREDECESSOR_SLOTS];
+            for (int k = 0; k < predecessorCount[cell]; k++)
+                prioritize(p[k]);
+        }
+        backups += n;
+        return n;
+    }
+
+    size_t queued(void) const {
+        return queue.size();
+    }
+
+    size_t backupCount(void) const {
+        return backups;
+    }
+
+    // Bytes of model, predecessor lists and queue
+    size_t bytes(void) const {
+        size_t pairs = cells * NUM_ACTIONS;
+        return pairs * SUCCESSOR_SLOTS * (sizeof(uint32_t) * 2 + sizeof(float))
+             + cells * (PREDECESSOR_SLOTS * sizeof(uint32_t) + 2)
+             + pairs * (sizeof(uint32_t) + sizeof(float) + sizeof(int32_t));
+    }
+};
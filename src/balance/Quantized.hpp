@@ -0,0 +1,385 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+#include "State.hpp"
+
+// Reduced precision action-value tables: the same tile coding as ActionValue with each weight
+// stored as an IEEE half (2 bytes) or as an int8 times a float scale shared by a block of
+// QUANT_BLOCK weights (a little over 1 byte).  Either can be filled from a trained float table or
+// trained directly.
+//
+// A TD step is often far smaller than the spacing of representable values (an int8 block holding
+// values near -40 is quantized in steps of about 0.4), so rounding each update to nearest would
+// throw most of them away.  Updates round stochastically instead: up with probability equal to the
+// fraction of the spacing covered, which makes every stored weight an unbiased estimate of the
+// float one would have been.  An int8 weight that outgrows its block's range rescales the block.
+
+enum class WeightFormat : uint16_t {
+    f32 = 0,
+    f16 = 1,
+    i8 = 2
+};
+
+inline const char* formatName(WeightFormat f) {
+    switch (f) {
+    case WeightFormat::f16:
+        return "fp16";
+    case WeightFormat::i8:
+        return "int8";
+    default:
+        return "f32";
+    }
+}
+
+// Weights per int8 scale factor: 16 features' action values, one cache line of weights
+constexpr size_t QUANT_BLOCK = 64;
+// A rescaled int8 block leaves this much room above the weight that overflowed it
+constexpr float INT8_HEADROOM = 1.25f;
+
+// Float to half, rounding to nearest even or toward zero
+inline uint16_t toHalf(float x, bool truncate = false) {
+#ifdef __F16C__
+    return truncate ? _cvtss_sh(x, _MM_FROUND_TO_ZERO) : _cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+#else
+    uint32_t b;
+    std::memcpy(&b, &x, sizeof b);
+    uint16_t sign = (b >> 16) & 0x8000;
+    if ((b & 0x7fffffff) > 0x7f800000)
+        return sign | 0x7e00;
+    int exp = int((b >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = b & 0x7fffff;
+    // Truncating a finite value stops at the largest half; infinity stays infinite
+    if (exp >= 31)
+        return sign | (truncate and (b & 0x7fffffff) != 0x7f800000 ? 0x7bff : 0x7c00);
+    int shift = 13;
+    uint32_t h;
+    if (exp <= 0) {
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        shift = 14 - exp;
+        h = mant >> shift;
+    }
+    else {
+        h = uint32_t(exp) << 10 | mant >> 13;
+    }
+    uint32_t rem = mant & ((1u << shift) - 1), half = 1u << (shift - 1);
+    // A carry out of the mantissa moves to the next exponent, as it should
+    if (not truncate and (rem > half or (rem == half and (h & 1))))
+        h++;
+    return uint16_t(sign | h);
+#endif
+}
+
+inline float fromHalf(uint16_t h) {
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t b;
+    if (exp == 0) {
+        float x = std::ldexp(float(mant), -24);
+        return sign ? -x : x;
+    }
+    if (exp == 31)
+        b = sign | 0x7f800000 | mant << 13;
+    else
+        b = sign | (exp - 15 + 127) << 23 | mant << 13;
+    float x;
+    std::memcpy(&x, &b, sizeof x);
+    return x;
+#endif
+}
+
+// Rounds to one of the two neighbouring halves, up with probability proportional to the distance
+// from the lower one.  noise is 32 uniform bits; the 13 mantissa bits a half drops are replaced by
+// their sum with 13 of them, and what's left is truncated.  Exact for normal halves; half
+// subnormals (below 6e-5) round with a slight bias toward zero.
+inline uint16_t toHalfStochastic(float x, uint32_t noise) {
+    uint32_t b;
+    std::memcpy(&b, &x, sizeof b);
+    if ((b & 0x7f800000) != 0x7f800000)
+        b += noise & 0x1fff;
+    std::memcpy(&x, &b, sizeof x);
+    return toHalf(x, true);
+}
+
+// x rounded to an integer, up with probability equal to its fractional part
+inline float roundStochastic(float x, uint32_t noise) {
+    return std::floor(x + float(noise >> 8) * 0x1.0p-24f);
+}
+
+template<WeightFormat Format, int AngleBins = ANGULAR_BUCKETS, int VelocityBins = VELOCITY_BUCKETS, int Actions = NUM_ACTIONS>
+class QuantizedValue {
+    static_assert(Format == WeightFormat::f16 or Format == WeightFormat::i8, "use ActionValue for float weights");
+
+public:
+    using Coder = TileCoder<AngleBins, VelocityBins>;
+    using Values = ActionValues<Actions>;
+    using Float = ActionValue<AngleBins, VelocityBins, Actions>;
+    using Stored = std::conditional_t<Format == WeightFormat::f16, uint16_t, int8_t>;
+    static constexpr int STRIDE = actionStride<Actions>();
+
+private:
+    Coder tiles;
+    size_t n;
+    std::vector<Stored> w;
+    std::vector<float> scales;      // int8 only, one per QUANT_BLOCK weights
+    Rng rng;
+    bool stochastic;
+
+    static size_t blocks(size_t weights) {
+        return (weights + QUANT_BLOCK - 1) / QUANT_BLOCK;
+    }
+
+    size_t blocks(void) const {
+        return blocks(n);
+    }
+
+    float weight(size_t i) const {
+        if constexpr (Format == WeightFormat::f16)
+            return fromHalf(w[i]);
+        else
+            return w[i] * scales[i / QUANT_BLOCK];
+    }
+
+    uint32_t noise(void) {
+        return uint32_t(rng.next() >> 32);
+    }
+
+    // x / scale as an int8, which the caller has made sure fits
+    int8_t quantize(float x, float inverseScale) {
+        float q = x * inverseScale;
+        q = stochastic ? roundStochastic(q, noise()) : std::nearbyint(q);
+        return int8_t(std::min(std::max(q, -127.0f), 127.0f));
+    }
+
+    // Widens block b's range so that it holds magnitude, requantizing its weights
+    void rescale(size_t b, float magnitude) {
+        float old = scales[b];
+        float scale = magnitude * INT8_HEADROOM / 127;
+        size_t end = std::min(n, (b + 1) * QUANT_BLOCK);
+        for (size_t i = b * QUANT_BLOCK; i < end; i++)
+            w[i] = quantize(w[i] * old, 1 / scale);
+        scales[b] = scale;
+    }
+
+    void store(size_t i, float x) {
+        if constexpr (Format == WeightFormat::f16) {
+            w[i] = stochastic ? toHalfStochastic(x, noise()) : toHalf(x);
+        }
+        else {
+            size_t b = i / QUANT_BLOCK;
+            if (std::fabs(x) > 127 * scales[b])
+                rescale(b, std::fabs(x));
+            if (scales[b] > 0)
+                w[i] = quantize(x, 1 / scales[b]);
+        }
+    }
+
+public:
+    QuantizedValue(int tilings = NUM_TILINGS, size_t hashSize = 0, bool stochastic = true, uint64_t seed = DEFAULT_SEED):
+        tiles(tilings, hashSize), n(tiles.size() * STRIDE), w(n, Stored(0)), rng(seed), stochastic(stochastic)
+    {
+        if constexpr (Format == WeightFormat::i8)
+            scales.assign(blocks(), 0);
+    }
+
+    // Rounds a float table to nearest: each int8 block is scaled to its largest weight
+    QuantizedValue(const Float& Q, bool stochastic = true, uint64_t seed = DEFAULT_SEED):
+        QuantizedValue(Q.coder().numTilings(), Q.coder().hashSize(), stochastic, seed)
+    {
+        fromFloat(Q.data());
+    }
+
+    void fromFloat(const float* weights) {
+        if constexpr (Format == WeightFormat::f16) {
+            for (size_t i = 0; i < n; i++)
+                w[i] = toHalf(weights[i]);
+        }
+        else {
+            for (size_t b = 0; b < blocks(); b++) {
+                size_t begin = b * QUANT_BLOCK, end = std::min(n, begin + QUANT_BLOCK);
+                float largest = 0;
+                for (size_t i = begin; i < end; i++)
+                    largest = std::max(largest, std::fabs(weights[i]));
+                scales[b] = largest / 127;
+                for (size_t i = begin; i < end; i++)
+                    w[i] = largest > 0 ? int8_t(std::nearbyint(weights[i] / scales[b])) : 0;
+            }
+        }
+    }
+
+    void toFloat(float* out) const {
+        for (size_t i = 0; i < n; i++)
+            out[i] = weight(i);
+    }
+
+    const Coder& coder(void) const {
+        return tiles;
+    }
+
+    // Number of weights
+    size_t size(void) const {
+        return n;
+    }
+
+    size_t bytes(void) const {
+        return w.size() * sizeof(Stored) + scales.size() * sizeof(float);
+    }
+
+    void active(const State& x, Features& out) const {
+        tiles.active(x, out);
+    }
+
+    float value(const Features& f, Action a) const {
+        float q = 0;
+        for (int t = 0; t < f.count; t++)
+            q += weight(size_t(f.idx[t]) * STRIDE + static_cast<size_t>(a));
+        return q;
+    }
+
+    Values values(const Features& f) const {
+        Values out = {};
+        for (int t = 0; t < f.count; t++) {
+            size_t cell = size_t(f.idx[t]) * STRIDE;
+            if constexpr (Format == WeightFormat::f16) {
+#ifdef __F16C__
+                static_assert(STRIDE == 4, "one 64 bit load per feature");
+                __m128 v = _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&w[cell])));
+                _mm_storeu_ps(out.q, _mm_add_ps(_mm_loadu_ps(out.q), v));
+                continue;
+#endif
+            }
+            const float s = Format == WeightFormat::i8 ? scales[cell / QUANT_BLOCK] : 1;
+            for (int k = 0; k < STRIDE; k++)
+                out.q[k] += Format == WeightFormat::i8 ? w[cell + k] * s : weight(cell + k);
+        }
+        return out;
+    }
+
+    Values values(const State& x) const {
+        Features f;
+        active(x, f);
+        return values(f);
+    }
+
+    float operator() (const State& x, Action a) const {
+        Features f;
+        active(x, f);
+        return value(f, a);
+    }
+
+    void update(const Features& f, Action a, float step) {
+        for (int t = 0; t < f.count; t++) {
+            size_t i = size_t(f.idx[t]) * STRIDE + static_cast<size_t>(a);
+            store(i, weight(i) + step);
+        }
+    }
+
+    Action greedy(const State& x, double eps = 1) const {
+        if (uniform() < eps)
+            return Float::argmax(values(x));
+        else
+            return static_cast<Action>(uniformInt(0, Actions));
+    }
+
+    // Raw storage: the weights, then for int8 the block scales
+    // Bytes write() takes for a table of this many weights, without building one
+    static size_t payloadBytes(size_t weights) {
+        return weights * sizeof(Stored) + (Format == WeightFormat::i8 ? blocks(weights) * sizeof(float) : 0);
+    }
+
+    size_t payloadBytes(void) const {
+        return payloadBytes(n);
+    }
+
+    bool write(std::FILE* f) const {
+        return std::fwrite(w.data(), sizeof(Stored), w.size(), f) == w.size()
+           and std::fwrite(scales.data(), sizeof(float), scales.size(), f) == scales.size();
+    }
+
+    bool read(const void* data, size_t length) {
+        if (length < payloadBytes())
+            return false;
+        const char* p = static_cast<const char*>(data);
+        std::memcpy(w.data(), p, w.size() * sizeof(Stored));
+        std::memcpy(scales.data(), p + w.size() * sizeof(Stored), scales.size() * sizeof(float));
+        return true;
+    }
+};
+
+// One-step SARSA on a quantized table, with the interface runEpisode() trains
+template<WeightFormat Format>
+class QuantizedAgent {
+public:
+    typedef QuantizedValue<Format> Table;
+
+private:
+    float alpha = 1;
+    float gamma = 0.75;
+    std::unique_ptr<Table> Q;
+    float delta = 0;
+
+public:
+    QuantizedAgent(float alpha = 1, float gamma = 0.75, int tilings = NUM_TILINGS, size_t hashSize = 0, bool stochastic = true):
+        alpha(alpha), gamma(gamma), Q(std::make_unique<Table>(tilings, hashSize, stochastic)) {}
+
+    QuantizedAgent(float alpha, float gamma, std::unique_ptr<Table> Q): alpha(alpha), gamma(gamma), Q(std::move(Q)) {}
+
+    float stepSize(void) const {
+        return alpha;
+    }
+
+    float discount(void) const {
+        return gamma;
+    }
+
+    void beginEpisode(void) {}
+
+    void updateSarsa(const State& cur, Action curAct, double reward, const State& prev, Action prevAct) {
+        Features f;
+        Q->active(prev, f);
+        double target = cur.broken ? reward : reward + gamma * (*Q)(cur, curAct);
+        delta = target - Q->value(f, prevAct);
+        Q->update(f, prevAct, alpha * delta / f.count);
+    }
+
+    float tdError(void) const {
+        return delta;
+    }
+
+    Action greedy(const State& x, double epsilon = 1) const {
+        return Q->greedy(x, epsilon);
+    }
+
+    Table& values(void) {
+        return *Q;
+    }
+
+    const Table& values(void) const {
+        return *Q;
+    }
+
+    // The weights widened back to floats, as an Agent with the same hyperparameters
+    std::unique_ptr<Agent> toFloat(void) const {
+        auto table = std::make_unique<Agent::Table>(Q->coder().numTilings(), Q->coder().hashSize());
+        Q->toFloat(table->data());
+        return std::make_unique<Agent>(alpha, gamma, std::move(table));
+    }
+
+    void dump(const std::string& path = "data.csv") const {
+        toFloat()->dump(path);
+    }
+};
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Random numbers for training.  Every thread has its own xoshiro256+ generator, so there's no
+// shared state to contend on, and a run seeded with seedThread() draws exactly the same sequence
+// every time.  Threads that never call seedThread() all start from DEFAULT_SEED, so parallel
+// workers should each be given their own seed.
+
+constexpr uint64_t DEFAULT_SEED = 0;
+
+// Expands one 64 bit seed into well mixed generator state
+constexpr uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+constexpr uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Top 53 bits as a double in [0, 1)
+constexpr double toUnit(uint64_t x) {
+    return (x >> 11) * 0x1.0p-53;
+}
+
+// xoshiro256+, the variant meant for generating floating point numbers
+class Rng {
+private:
+    uint64_t s[4] = {};
+
+public:
+    constexpr explicit Rng(uint64_t seed = DEFAULT_SEED) {
+        this->seed(seed);
+    }
+
+    constexpr void seed(uint64_t seed) {
+        for (auto& x : s)
+            x = splitmix64(seed);
+    }
+
+    constexpr uint64_t next(void) {
+        uint64_t result = s[0] + s[3];
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1)
+    constexpr double uniform(void) {
+        return toUnit(next());
+    }
+
+    // Uniform integer in [start, end)
+    constexpr int uniformInt(int start, int end) {
+        return int(uniform() * (end - start)) + start;
+    }
+};
+
+// RNG_LANES independent xoshiro256+ streams kept as structure-of-arrays, so filling an array runs
+// all the streams side by side in vector registers.  Used for drawing exploration noise for a whole
+// batch of environments at once.
+constexpr int RNG_LANES = 8;
+
+class BatchRng {
+private:
+    alignas(64) uint64_t s0[RNG_LANES];
+    alignas(64) uint64_t s1[RNG_LANES];
+    alignas(64) uint64_t s2[RNG_LANES];
+    alignas(64) uint64_t s3[RNG_LANES];
+
+public:
+    explicit BatchRng(uint64_t seed = DEFAULT_SEED) {
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed) {
+        for (int i = 0; i < RNG_LANES; i++) {
+            s0[i] = splitmix64(seed);
+            s1[i] = splitmix64(seed);
+            s2[i] = splitmix64(seed);
+            s3[i] = splitmix64(seed);
+        }
+    }
+
+    // Fills out[0, n) with uniforms in [0, 1)
+    void fill(double* out, size_t n) {
+        size_t i = 0;
+        for (; i + RNG_LANES <= n; i += RNG_LANES) {
+            for (int j = 0; j < RNG_LANES; j++) {
+                uint64_t result = s0[j] + s3[j];
+                uint64_t t = s1[j] << 17;
+                s2[j] ^= s0[j];
+                s3[j] ^= s1[j];
+                s1[j] ^= s2[j];
+                s0[j] ^= s3[j];
+                s2[j] ^= t;
+                s3[j] = (s3[j] << 45) | (s3[j] >> 19);
+                out[i + j] = toUnit(result);
+            }
+        }
+        if (i < n) {
+            alignas(64) double tail[RNG_LANES];
+            fill(tail, RNG_LANES);
+            for (int j = 0; i < n; i++, j++)
+                out[i] = tail[j];
+        }
+    }
+};
+
+thread_local Rng threadRng;
+
+// Reseeds the calling thread's generator
+void seedThread(uint64_t seed) {
+    threadRng.seed(seed);
+}
+
+double uniform(void) {
+    return threadRng.uniform();
+}
+
+int uniformInt(int start, int end) {
+    return threadRng.uniformInt(start, end);
+}
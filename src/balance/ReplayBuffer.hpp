@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "State.hpp"
+
+// Experience replay.  Transitions go into a fixed-capacity ring buffer stored as structure-of-arrays,
+// and training replays random minibatches of them so that each physics rollout feeds many weight
+// updates.  With prioritized replay, transitions are drawn in proportion to (|TD error| + eps)^alpha
+// from a sum tree, and their updates are scaled by importance-sampling weights.
+//
+// Replayed transitions come from older policies, so the batch update bootstraps off-policy from
+// max_a Q(next, a) rather than the action that happened to be taken next.
+
+constexpr int MAX_REPLAY_BATCH = 256;
+constexpr float PRIORITY_ALPHA = 0.6;
+constexpr float PRIORITY_BETA = 0.4;
+constexpr float PRIORITY_EPS = 1e-3;
+
+class ReplayBuffer {
+public:
+    std::vector<double> theta, L, nextTheta, nextL;
+    std::vector<float> reward;
+    std::vector<uint8_t> action;
+    std::vector<uint8_t> flags;       // tl_on | tr_on << 1 of the state acted from
+    std::vector<uint8_t> nextFlags;
+    std::vector<uint8_t> terminal;
+
+private:
+    size_t cap;
+    size_t head = 0;
+    size_t count = 0;
+    bool prioritized;
+
+    // Sum tree over priorities: leaves start at tree[leaves], parents hold the sum of their children
+    size_t leaves = 1;
+    std::vector<double> tree;
+    double maxPriority = 1;
+
+    void setLeaf(size_t i, double p) {
+        size_t k = leaves + i;
+        double delta = p - tree[k];
+        for (; k >= 1; k /= 2)
+            tree[k] += delta;
+    }
+
+    // Leaf whose prefix-sum interval contains u
+    size_t find(double u) const {
+        size_t k = 1;
+        while (k < leaves) {
+            if (u < tree[2 * k] or tree[2 * k + 1] <= 0) {
+                k = 2 * k;
+            }
+            else {
+                u -= tree[2 * k];
+                k = 2 * k + 1;
+            }
+        }
+        return std::min(k - leaves, count - 1);
+    }
+
+public:
+    ReplayBuffer(size_t capacity, bool prioritized = false):
+        theta(capacity), L(capacity), nextTheta(capacity), nextL(capacity), reward(capacity),
+        action(capacity), flags(capacity), nextFlags(capacity), terminal(capacity),
+        cap(capacity), prioritized(prioritized)
+    {
+        if (prioritized) {
+            while (leaves < capacity)
+                leaves <<= 1;
+            tree.assign(2 * leaves, 0);
+        }
+    }
+
+    size_t size(void) const {
+        return count;
+    }
+
+    size_t capacity(void) const {
+        return cap;
+    }
+
+    bool isPrioritized(void) const {
+        return prioritized;
+    }
+
+    // Overwrites the oldest transition once full.  New transitions get the highest priority seen so
+    // far, so each is replayed at least once soon.
+    void push(const State& prev, Action a, double r, const State& next) {
+        size_t i = head;
+        theta[i] = prev.theta;
+        L[i] = prev.L;
+        flags[i] = prev.tl_on | (prev.tr_on << 1);
+        action[i] = static_cast<uint8_t>(a);
+        reward[i] = r;
+        nextTheta[i] = next.theta;
+        nextL[i] = next.L;
+        nextFlags[i] = next.tl_on | (next.tr_on << 1);
+        terminal[i] = next.broken;
+        if (prioritized)
+            setLeaf(i, maxPriority);
+        head = (head + 1 == cap) ? 0 : head + 1;
+        count = std::min(count + 1, cap);
+    }
+
+    State state(size_t i) const {
+        return State{theta[i], L[i], bool(flags[i] & 1), bool(flags[i] & 2), false};
+    }
+
+    State nextState(size_t i) const {
+        return State{nextTheta[i], nextL[i], bool(nextFlags[i] & 1), bool(nextFlags[i] & 2), bool(terminal[i])};
+    }
+
+    // Draws n transition indices, with importance-sampling weights normalised so the largest is 1.
+    // Prioritized draws are stratified: one from each of n equal slices of the total priority.
+    void sample(int n, uint32_t* idx, float* weight) const {
+        if (not prioritized) {
+            for (int k = 0; k < n; k++) {
+                idx[k] = std::min<size_t>(uniform() * count, count - 1);
+                weight[k] = 1;
+            }
+            return;
+        }
+        double total = tree[1];
+        double slice = total / n;
+        float maxWeight = 0;
+        for (int k = 0; k < n; k++) {
+            idx[k] = find((k + uniform()) * slice);
+            double p = tree[leaves + idx[k]] / total;
+            weight[k] = std::pow(count * p, -PRIORITY_BETA);
+            maxWeight = std::max(maxWeight, weight[k]);
+        }
+        for (int k = 0; k < n; k++)
+            weight[k] /= maxWeight;
+    }
+
+    void setPriority(size_t i, double tdError) {
+        if (not prioritized)
+            return;
+        double p = std::pow(std::abs(tdError) + PRIORITY_EPS, PRIORITY_ALPHA);
+        maxPriority = std::max(maxPriority, p);
+        setLeaf(i, p);
+    }
+};
+
+// One minibatch of n replayed TD updates with step size alpha.  Every target is computed from the
+// weights as they were before the batch and then all the updates are applied in a second pass, so the
+// batch's lookups don't wait on its own writes.  A transition drawn twice in one batch is updated
+// twice, so alpha should be smaller than for online updates.
+template<typename A>
+void replayBatch(A& agent, ReplayBuffer& buffer, int n, float alpha) {
+    if (buffer.size() == 0)
+        return;
+    n = std::min(n, MAX_REPLAY_BATCH);
+    auto& Q = agent.values();
+    float gamma = agent.discount();
+
+    std::array<uint32_t, MAX_REPLAY_BATCH> idx;
+    std::array<float, MAX_REPLAY_BATCH> weight;
+    std::array<Features, MAX_REPLAY_BATCH> features;
+    std::array<float, MAX_REPLAY_BATCH> delta;
+    buffer.sample(n, idx.data(), weight.data());
+
+    for (int k = 0; k < n; k++) {
+        size_t i = idx[k];
+        Action a = static_cast<Action>(buffer.action[i]);
+        Q.active(buffer.state(i), features[k]);
+        double target = buffer.reward[i];
+        if (not buffer.terminal[i]) {
+            auto next = Q.values(buffer.nextState(i));
+            target += gamma * next[ActionValue<>::argmax(next)];
+        }
+        delta[k] = target - Q.value(features[k], a);
+    }
+
+    for (int k = 0; k < n; k++) {
+        Action a = static_cast<Action>(buffer.action[idx[k]]);
+        Q.update(features[k], a, alpha * weight[k] * delta[k] / features[k].count);
+        buffer.setPriority(idx[k], delta[k]);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Fixed-timestep pacing on steady_clock.  wait() sleeps until the next step is due rather than
+// spinning, and returns how many steps are due: normally 1, more if the caller fell behind, capped
+// at maxCatchUp so that a stall (a dragged window, a debugger) doesn't turn into a burst of steps.
+class FixedTimestep {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::duration step;
+    Clock::time_point next;
+    int maxCatchUp;
+
+public:
+    FixedTimestep(double seconds, int maxCatchUp = 10):
+        step(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds))),
+        next(Clock::now()), maxCatchUp(maxCatchUp) {}
+
+    int wait(void) {
+        std::this_thread::sleep_until(next);
+        auto now = Clock::now();
+        int due = int((now - next) / step) + 1;
+        if (due > maxCatchUp) {
+            // Give up on the lost time instead of trying to make it up
+            due = maxCatchUp;
+            next = now;
+        }
+        next += due * step;
+        return due;
+    }
+
+    // When the step after the ones just returned by wait() is due
+    Clock::time_point deadline(void) const {
+        return next;
+    }
+
+    double seconds(void) const {
+        return std::chrono::duration<double>(step).count();
+    }
+};
@@ -0,0 +1,349 @@
+#pragma once
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "State.hpp"
+
+// Policy serving over a Unix domain stream socket.  A request is a RequestHeader followed by count
+// (theta, L) pairs; the answer is a RequestHeader with the same id and count followed by one Answer
+// per state, in order.  Clients may pipeline requests on one connection.  Everything is in host
+// byte order, since both ends are on the same machine.
+//
+// The server is a single epoll loop.  Each time it wakes it reads every ready connection, gathers
+// all complete requests from all clients into one batch, evaluates Q for the whole batch and then
+// writes the answers back, so concurrent clients share the cost of each pass through the table.
+//
+// A client may half-close its end once it has sent its last request: the server stops reading,
+// answers every complete request it already has and closes the connection once they're written.
+// A connection whose unsent answers reach SERVE_MAX_BACKLOG isn't read from until the client
+// has taken some of them, so a client that stops reading can't make the server buffer without
+// limit.
+
+constexpr const char* DEFAULT_SOCKET = "/tmp/balance.sock";
+constexpr uint32_t MAX_REQUEST_STATES = 4096;
+constexpr int SERVE_EVENTS = 256;
+constexpr size_t SERVE_READ_CHUNK = 1 << 16;
+constexpr size_t SERVE_MAX_BACKLOG = 1 << 20;   // bytes, per connection
+
+struct RequestHeader {
+    uint32_t id;
+    uint32_t count;
+};
+
+struct Query {
+    double theta;
+    double L;
+};
+
+struct Answer {
+    float q[NUM_ACTIONS];
+    int32_t action;
+};
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof addr.sun_path - 1);
+    return addr;
+}
+
+// Blocking helpers for clients
+bool sendAll(int fd, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        ssize_t k = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 and errno == EINTR)
+            continue;
+        if (k <= 0)
+            return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+bool recvAll(int fd, void* data, size_t n) {
+    char* p = static_cast<char*>(data);
+    while (n > 0) {
+        ssize_t k = ::recv(fd, p, n, 0);
+        if (k < 0 and errno == EINTR)
+            continue;
+        if (k <= 0)
+            return false;
+        p += k;
+        n -= k;
+    }
+    return true;
+}
+
+int connectSocket(const std::string& path) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socketAddress(path);
+    if (fd < 0 or ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        std::cerr << "Can't connect to " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct ServeStats {
+    size_t connections = 0;
+    size_t requests = 0;
+    size_t states = 0;
+    size_t batches = 0;
+    size_t largestBatch = 0;    // states
+};
+
+volatile std::sig_atomic_t serveStop = 0;
+
+class PolicyServer {
+private:
+    struct Connection {
+        int fd;
+        uint64_t serial;        // fds get reused, serials don't
+        std::vector<uint8_t> in = {};
+        std::vector<uint8_t> out = {};
+        size_t sent = 0;
+        size_t queued = 0;      // requests in the current batch
+        bool eof = false;       // the client won't send any more
+        uint32_t events = EPOLLIN;  // what epoll is watching for
+
+        size_t backlog(void) const {
+            return out.size() - sent;
+        }
+
+        // Closed by the client with nothing left to answer
+        bool done(void) const {
+            return eof and queued == 0 and backlog() == 0;
+        }
+    };
+
+    // A request waiting in the current batch
+    struct Pending {
+        int fd;
+        uint64_t serial;
+        uint32_t id;
+        size_t first;
+        uint32_t count;
+    };
+
+    const ActionValue<>& Q;
+    int listener = -1;
+    int epoll = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Pending> pending;
+    std::vector<Query> queries;
+    std::vector<Answer> answers;
+    std::vector<int> touched;
+    ServeStats stats;
+
+    void drop(int fd) {
+        ::epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+
+    // Reads while the client may still send and isn't too far behind, writes while output is queued
+    void watch(Connection& c) {
+        uint32_t events = 0;
+        if (not c.eof and c.backlog() < SERVE_MAX_BACKLOG)
+            events |= EPOLLIN;
+        if (c.backlog() > 0)
+            events |= EPOLLOUT;
+        if (c.events == events)
+            return;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = c.fd;
+        ::epoll_ctl(epoll, EPOLL_CTL_MOD, c.fd, &ev);
+        c.events = events;
+    }
+
+    void accept(void) {
+        while (true) {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            ::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &ev);
+            stats.connections++;
+            connections[fd] = std::make_unique<Connection>(Connection{fd, stats.connections});
+        }
+    }
+
+    // Reads what's available, up to the backlog limit, and queues every complete request.  False if
+    // the connection failed or sent a bad request.
+    bool receive(Connection& c) {
+        while (not c.eof and c.in.size() < SERVE_MAX_BACKLOG) {
+            size_t used = c.in.size();
+            c.in.resize(used + SERVE_READ_CHUNK);
+            ssize_t k = ::recv(c.fd, c.in.data() + used, SERVE_READ_CHUNK, 0);
+            c.in.resize(used + std::max<ssize_t>(k, 0));
+            if (k == 0) {
+                c.eof = true;
+                break;
+            }
+            if (k < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN or errno == EWOULDBLOCK)
+                    break;
+                return false;
+            }
+        }
+
+        size_t pos = 0;
+        while (c.in.size() - pos >= sizeof(RequestHeader)) {
+            RequestHeader h;
+            std::memcpy(&h, c.in.data() + pos, sizeof h);
+            if (h.count > MAX_REQUEST_STATES)
+                return false;
+            size_t body = size_t(h.count) * sizeof(Query);
+            if (c.in.size() - pos - sizeof h < body)
+                break;
+            pending.push_back(Pending{c.fd, c.serial, h.id, queries.size(), h.count});
+            queries.resize(queries.size() + h.count);
+            std::memcpy(queries.data() + pending.back().first, c.in.data() + pos + sizeof h, body);
+            pos += sizeof h + body;
+            c.queued++;
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + pos);
+        watch(c);
+        return true;
+    }
+
+    // Writes as much queued output as the socket takes.  False if the connection failed.
+    bool flush(Connection& c) {
+        while (c.sent < c.out.size()) {
+            ssize_t k = ::send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (k < 0 and errno == EINTR)
+                continue;
+            if (k < 0 and (errno == EAGAIN or errno == EWOULDBLOCK))
+                break;
+            if (k <= 0)
+                return false;
+            c.sent += k;
+        }
+        if (c.sent == c.out.size()) {
+            c.out.clear();
+            c.sent = 0;
+        }
+        watch(c);
+        return true;
+    }
+
+    // Evaluates every queued state in one pass and hands the answers back to their connections
+    void serveBatch(void) {
+        if (pending.empty())
+            return;
+        answers.resize(queries.size());
+        for (size_t k = 0; k < queries.size(); k++) {
+            auto q = Q.values(State{queries[k].theta, queries[k].L, false, false, false});
+            for (int a = 0; a < NUM_ACTIONS; a++)
+                answers[k].q[a] = q.q[a];
+            answers[k].action = static_cast<int32_t>(Q.argmax(q));
+        }
+
+        touched.clear();
+        for (const Pending& p : pending) {
+            auto it = connections.find(p.fd);
+            if (it == connections.end() or it->second->serial != p.serial)
+                continue;
+            Connection& c = *it->second;
+            RequestHeader h{p.id, p.count};
+            const uint8_t* head = reinterpret_cast<const uint8_t*>(&h);
+            const uint8_t* body = reinterpret_cast<const uint8_t*>(answers.data() + p.first);
+            c.out.insert(c.out.end(), head, head + sizeof h);
+            c.out.insert(c.out.end(), body, body + size_t(p.count) * sizeof(Answer));
+            c.queued--;
+            if (touched.empty() or touched.back() != p.fd)
+                touched.push_back(p.fd);
+        }
+        for (int fd : touched) {
+            auto it = connections.find(fd);
+            if (it != connections.end() and (not flush(*it->second) or it->second->done()))
+                drop(fd);
+        }
+
+        stats.requests += pending.size();
+        stats.states += queries.size();
+        stats.batches++;
+        stats.largestBatch = std::max(stats.largestBatch, queries.size());
+        pending.clear();
+        queries.clear();
+    }
+
+public:
+    PolicyServer(const ActionValue<>& Q): Q(Q) {}
+
+    ~PolicyServer() {
+        for (auto& c : connections)
+            ::close(c.first);
+        if (listener >= 0)
+            ::close(listener);
+        if (epoll >= 0)
+            ::close(epoll);
+    }
+
+    bool listen(const std::string& path) {
+        ::unlink(path.c_str());
+        listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_un addr = socketAddress(path);
+        if (listener < 0 or ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0
+            or ::listen(listener, SOMAXCONN) != 0) {
+            std::cerr << "Can't listen on " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        epoll = ::epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listener;
+        ::epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &ev);
+        return true;
+    }
+
+    // Serves until serveStop is set, e.g. by a signal handler
+    void run(void) {
+        epoll_event events[SERVE_EVENTS];
+        while (not serveStop) {
+            int n = ::epoll_wait(epoll, events, SERVE_EVENTS, 100);
+            for (int e = 0; e < n; e++) {
+                int fd = events[e].data.fd;
+                if (fd == listener) {
+                    accept();
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end())
+                    continue;
+                Connection& c = *it->second;
+                bool ok = true;
+                if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    ok = receive(c);
+                if (ok and (events[e].events & EPOLLOUT))
+                    ok = flush(c);
+                if (not ok or c.done())
+                    drop(fd);
+            }
+            serveBatch();
+        }
+    }
+
+    const ServeStats& statistics(void) const {
+        return stats;
+    }
+};
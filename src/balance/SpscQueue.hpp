@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.  The producer
+// only writes tail and the consumer only writes head, each on its own cache line, and each side
+// keeps a cached copy of the other's index so it only reads the shared one when it looks full or
+// empty.  Capacity is rounded up to a power of two.
+template<typename T>
+class SpscQueue {
+private:
+    std::vector<T> slots;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;      // consumer's view of tail
+
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;      // producer's view of head
+
+public:
+    SpscQueue(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity)
+            n <<= 1;
+        slots.resize(n);
+        mask = n - 1;
+    }
+
+    size_t capacity(void) const {
+        return slots.size();
+    }
+
+    // Approximate when called from a third thread
+    size_t size(void) const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    // Producer only.  False if the queue is full.
+    bool push(const T& x) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == slots.size()) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == slots.size())
+                return false;
+        }
+        slots[t & mask] = x;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.  False if the queue is empty.
+    bool pop(T& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail)
+                return false;
+        }
+        out = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
@@ -1,36 +1,46 @@
+#pragma once
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <stdlib.h>
 #include <vector> 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <functional>
+#include <new>
 #include <string>
 #include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "Random.hpp"
+#include "EligibilityTraces.hpp"
+#include "FastMath.hpp"
 
 // Helpers 
-double sample(void) {
-    return (double) rand() / INT_MAX; 
-}
-
-int sample(int start, int end) {
-    return (int) (sample() * (end - start)) + start;
-}
-
 // Computes angle in range [-pi, pi]
 template<typename T>
 double angle(T x) {
+#ifdef BALANCE_FAST_MATH
+    return wrapAngle(x);
+#else
     x = std::fmod(x + M_PI, 2 * M_PI);
     if (x < 0)
         x += 2 * M_PI;
     return x - M_PI;
+#endif
     //return x - 2 * M_PI * std::floor( x / (2 * M_PI) );
 }
 
 template<typename T>
 double angle2pi(T x) {
+#ifdef BALANCE_FAST_MATH
+    return wrap2pi(x);
+#else
     x = std::fmod(x, 2 * M_PI);
     if (x < 0)
         x += 2 * M_PI;
     return x;
+#endif
     //return x - 2 * M_PI * std::floor( x / (2 * M_PI) );
 }
 
@@ -70,7 +80,6 @@ struct State {
     bool tl_on;
     bool tr_on;
     bool broken;
-    std::string player;
     void print(void) {
         std::cout << "Angle: " << angle(theta) << std::endl;
         std::cout << "Angular Momentum: " << L << std::endl;
@@ -96,7 +105,8 @@ double Environment::reward(const State& prev, Action a, State& cur) {
     if (a == Action::torqueL or a == Action::torqueR)
         act = 1;
 
-    return -(angle(cur.theta) * angle(cur.theta) + cur.L * cur.L + act);
+    double theta = angle(cur.theta);
+    return -(theta * theta + cur.L * cur.L + act);
     //return std::cos(angle(cur.theta)); 
 
 /* OLD REWARD STRUCTURE
@@ -107,6 +117,36 @@ double Environment::reward(const State& prev, Action a, State& cur) {
 */
 }
 
+// The physics' sine: the polynomial one in fast math builds, std::sin otherwise
+inline double physicsSin(double x) {
+#ifdef BALANCE_FAST_MATH
+    return fastSin(x);
+#else
+    return std::sin(x);
+#endif
+}
+
+// Advance the pendulum by one PHYSICS_TIMESTEP with the given motor torques.  Fast math builds
+// keep theta in [-pi, pi) so that its sine never needs a large reduction.
+inline void update(State& state, double torqueL, double torqueR) {
+    double F_theta = (state.tl_on ? torqueL : 0) + (state.tr_on ? torqueR : 0) - MASS * GRAVITY_FORCE * physicsSin(state.theta);
+    double angularMomentumUpdate = F_theta * PHYSICS_TIMESTEP / MOMENT_OF_INERTIA;
+    // L = I*omega
+    //if ( (state.L + angularMomentumUpdate) / MOMENT_OF_INERTIA <= MAX_VELOCITY and 
+    //     (state.L + angularMomentumUpdate) / MOMENT_OF_INERTIA >= MIN_VELOCITY)
+    state.L += angularMomentumUpdate;
+        
+    state.theta += PHYSICS_TIMESTEP * state.L;
+#ifdef BALANCE_FAST_MATH
+    state.theta = rewrap(state.theta);
+#endif
+}
+
+// The compiled-in torques fold into constants once this is inlined
+void update(State& state) {
+    update(state, TORQUE_L, TORQUE_R);
+}
+
 void act(State& x, Action a) {
     switch (a) {
     case Action::off:
@@ -123,128 +163,351 @@ void act(State& x, Action a) {
 }
 
 
-class ActionValue {
+// Tile coding over (angle, angular momentum).  Each tiling is an AngleBins x VelocityBins grid
+// shifted by a fraction of a tile, so a state activates one tile per tiling and nearby states
+// share most of their tiles.  Tilings are displaced by (1, 3) / tilings of a tile width, which
+// avoids the diagonal artifacts of shifting both coordinates by the same amount.
+constexpr int MAX_TILINGS = 16;
+constexpr int NUM_TILINGS = 8;
+
+// Active feature indices for one state, one per tiling
+struct Features {
+    std::array<uint32_t, MAX_TILINGS> idx;
+    int count;
+};
+
+template<int AngleBins = ANGULAR_BUCKETS, int VelocityBins = VELOCITY_BUCKETS>
+class TileCoder {
 private:
-    std::vector<float> w;
+    int tilings;
+    size_t hashMask;   // 0 when every tile has its own feature
+    size_t features;
+
+    // Angle is periodic, so shifted angular tiles wrap around.  Velocity tiles are shifted over an
+    // extra bucket so that the whole [MIN_VELOCITY, MAX_VELOCITY] range is covered in every tiling;
+    // out of range momenta are clamped to the edge tiles.
+    static constexpr int VELOCITY_TILES = VelocityBins + 1;
+    static constexpr size_t TILES_PER_TILING = size_t(AngleBins) * VELOCITY_TILES;
+    static constexpr double ANGLE_WIDTH = 2 * M_PI / AngleBins;
+    static constexpr double VELOCITY_WIDTH = (MAX_VELOCITY - MIN_VELOCITY) / VelocityBins;
+
+    size_t TileAngleIdx(double scaledAngle, double tileOffset) const {
+        int i = int(scaledAngle + tileOffset);
+        return i >= AngleBins ? i - AngleBins : i;
+    }
 
-    size_t TileAngleIdx(const State& x, double tileOffset = 0) {
-        return std::floor( angle2pi(x.theta) / (2 * M_PI / ANGULAR_BUCKETS) ); 
+    size_t TileVeloIdx(double scaledVelo, double tileOffset) const {
+        double j = std::floor(scaledVelo + tileOffset);
+        return std::min(std::max(j, 0.0), VELOCITY_TILES - 1.0);
     }
 
-    size_t TileVeloIdx(const State& x, double tileOffset = 0) {
-        return std::floor( (x.L - MIN_VELOCITY) / ( (MAX_VELOCITY - MIN_VELOCITY) / VELOCITY_BUCKETS) );
+    static uint64_t hash(uint64_t tiling, uint64_t tile) {
+        uint64_t h = (tiling * 0x9E3779B97F4A7C15ULL) ^ (tile * 0xC2B2AE3D27D4EB4FULL);
+        return h ^ (h >> 29);
     }
 
 public:
-    ActionValue(void): w(VELOCITY_BUCKETS * ANGULAR_BUCKETS * NUM_ACTIONS, 0) {
+    // hashSize of 0 gives every tile of every tiling its own feature; otherwise tiles are hashed
+    // into a table of that many features, rounded up to a power of two
+    TileCoder(int tilings = NUM_TILINGS, size_t hashSize = 0): tilings(std::min(std::max(tilings, 1), MAX_TILINGS)), hashMask(0) {
+        if (hashSize == 0) {
+            features = size_t(this->tilings) * TILES_PER_TILING;
+        }
+        else {
+            features = 1;
+            while (features < hashSize)
+                features <<= 1;
+            hashMask = features - 1;
+        }
+    }
+
+    int numTilings(void) const {
+        return tilings;
+    }
+
+    size_t size(void) const {
+        return features;
+    }
+
+    // Size of the hash table, or 0 if tiles aren't hashed
+    size_t hashSize(void) const {
+        return hashMask ? features : 0;
+    }
+
+    void active(const State& x, Features& out) const {
+        double a = angle2pi(x.theta) / ANGLE_WIDTH;
+        double v = (x.L - MIN_VELOCITY) / VELOCITY_WIDTH;
+        out.count = tilings;
+        for (int t = 0; t < tilings; t++) {
+            size_t i = TileAngleIdx(a, double(t) / tilings);
+            size_t j = TileVeloIdx(v, double(3 * t % tilings) / tilings);
+            size_t tile = i + AngleBins * j;
+            if (hashMask)
+                out.idx[t] = hash(t, tile) & hashMask;
+            else
+                out.idx[t] = t * TILES_PER_TILING + tile;
+        }
+    }
+};
+
+
+// Every action's value for one state, padded to a power of two so it sits in one aligned block
+template<int Actions>
+constexpr int actionStride(void) {
+    int stride = 1;
+    while (stride < Actions)
+        stride <<= 1;
+    return stride;
+}
+
+template<int Actions>
+struct alignas(actionStride<Actions>() * sizeof(float)) ActionValues {
+    float q[actionStride<Actions>()];
+
+    float operator[] (Action a) const {
+        return q[static_cast<size_t>(a)];
+    }
+};
+
+// Linear action-value function over tile-coded features: Q(x, a) is the sum of one weight per tiling.
+// The weights of every action for a feature are stored next to each other, so one lookup per tiling
+// brings in the values of all actions.
+template<int AngleBins = ANGULAR_BUCKETS, int VelocityBins = VELOCITY_BUCKETS, int Actions = NUM_ACTIONS>
+class ActionValue {
+public:
+    using Coder = TileCoder<AngleBins, VelocityBins>;
+    using Values = ActionValues<Actions>;
+    static constexpr int STRIDE = actionStride<Actions>();
+    static constexpr size_t ALIGNMENT = 64;
+
+private:
+    Coder tiles;
+    size_t n;
+    // Usually owned, but the weights can also live in someone else's memory, e.g. a mapped checkpoint
+    std::unique_ptr<float[], std::function<void(float*)>> w;
+
+    static size_t actionIdx(Action a) {
+        return static_cast<size_t>(a);
+    }
+
+public:
+    ActionValue(int tilings = NUM_TILINGS, size_t hashSize = 0):
+        tiles(tilings, hashSize),
+        n(tiles.size() * STRIDE),
+        w(new (std::align_val_t(ALIGNMENT)) float[n](), [](float* p) { operator delete[](p, std::align_val_t(ALIGNMENT)); })
+    {
         // Initialize weights randomly
         //for (int i = 0; i < w.size(); i++)
-        //    w[i] = sample();
+        //    w[i] = uniform();
+    }
+
+    // Uses size() weights at the given address, calling release on them when destroyed.  The
+    // address must be aligned to the block of action values.
+    ActionValue(int tilings, size_t hashSize, float* weights, std::function<void(float*)> release):
+        tiles(tilings, hashSize),
+        n(tiles.size() * STRIDE),
+        w(weights, release) {}
 
-        for (auto& wt : w)
-            std::cout << wt << std::endl;
+    // Copies the weights of another table with the same tiling
+    void copyFrom(const ActionValue& other) {
+        std::copy(other.data(), other.data() + n, w.get());
     }
 
-    float& weight(int i, int j, int k) {
-        return w[ i + ANGULAR_BUCKETS * j + k * ANGULAR_BUCKETS * VELOCITY_BUCKETS ];
+    // Number of weights needed for the given tiling
+    static size_t tableSize(int tilings, size_t hashSize) {
+        return Coder(tilings, hashSize).size() * STRIDE;
     }
 
-    float& operator() (const State& x, Action a) {
-        size_t i = TileAngleIdx(x);
-        size_t j =  TileVeloIdx(x);
-        size_t k;
+    const Coder& coder(void) const {
+        return tiles;
+    }
 
-        switch (a) {
-        case Action::off:
-            k = 0;
-            break;
-        case Action::torqueL:
-            k = 1;
-            break;
-        case Action::torqueR:
-            k = 2;
-            break;
-        }
-        
-        return w[ i + ANGULAR_BUCKETS * j + k * ANGULAR_BUCKETS * VELOCITY_BUCKETS ];
+    size_t size(void) const {
+        return n;
     }
-    
-    // Returns pointers to the elements that need to be modified
-    std::vector<float *> grad(const State& x, Action a) {
-
-        size_t i = TileAngleIdx(x);
-        size_t j =  TileVeloIdx(x);
-        size_t k;
-
-        switch (a) {
-        case Action::off:
-            k = 0;
-            break;
-        case Action::torqueL:
-            k = 1;
-            break;
-        case Action::torqueR:
-            k = 2;
-            break;
-        }
 
-        return { 
-            &w[ i + ANGULAR_BUCKETS * j + k * ANGULAR_BUCKETS * VELOCITY_BUCKETS ] 
-        };
+    float* data(void) {
+        return w.get();
     }
 
-    Action greedy(const State& x, double eps = 1) {
-        if (sample() < eps) {
-            auto a = *std::max_element( 
-                Environment::actions.cbegin(),
-                Environment::actions.cend(),
-                [this, &x] (const Action& a, const Action& b) {
-                    return (*this)(x, a) < (*this)(x, b);
-                }
-            );
-            return a; 
-        }
-        else {
-            return Environment::actions[ sample(0, Environment::actions.size()) ]; 
+    const float* data(void) const {
+        return w.get();
+    }
+
+    // Position of feature f's weight for action a
+    size_t index(uint32_t f, Action a) const {
+        return size_t(f) * STRIDE + actionIdx(a);
+    }
+
+    // Active features of x, shared by every action
+    void active(const State& x, Features& out) const {
+        tiles.active(x, out);
+    }
+
+    float value(const Features& f, Action a) const {
+        const float* wa = w.get() + actionIdx(a);
+        float q = 0;
+        for (int t = 0; t < f.count; t++)
+            q += wa[ size_t(f.idx[t]) * STRIDE ];
+        return q;
+    }
+
+    Values values(const Features& f) const {
+        Values out = {};
+        for (int t = 0; t < f.count; t++) {
+            const float* cell = w.get() + size_t(f.idx[t]) * STRIDE;
+            for (int k = 0; k < STRIDE; k++)
+                out.q[k] += cell[k];
         }
+        return out;
+    }
+
+    // Q(x, a) for every action at once
+    Values values(const State& x) const {
+        Features f;
+        active(x, f);
+        return values(f);
+    }
+
+    float operator() (const State& x, Action a) const {
+        Features f;
+        active(x, f);
+        return value(f, a);
+    }
+
+    // Gradient of Q(x, a) is 1 on each active weight, so a TD update adds the same step to all of
+    // them in one pass
+    void update(const Features& f, Action a, float step) {
+        float* wa = w.get() + actionIdx(a);
+        for (int t = 0; t < f.count; t++)
+            wa[ size_t(f.idx[t]) * STRIDE ] += step;
+    }
+
+    // Ties go to the first action
+    static Action argmax(const Values& q) {
+        int best = 0;
+        for (int k = 1; k < Actions; k++)
+            if (q.q[best] < q.q[k])
+                best = k;
+        return static_cast<Action>(best);
+    }
+
+    Action greedy(const State& x, double eps = 1) const {
+        if (uniform() < eps)
+            return argmax(values(x));
+        else
+            return static_cast<Action>(uniformInt(0, Actions)); 
     }
 };
 
 
-class Agent {
+// The bucket counts are template parameters so the tile arithmetic stays constant-folded; Agent is
+// the compiled-in grid and other grids are instantiated where they are needed (see Sweep.hpp)
+template<int AngleBins = ANGULAR_BUCKETS, int VelocityBins = VELOCITY_BUCKETS>
+class BasicAgent {
+public:
+    typedef ActionValue<AngleBins, VelocityBins> Table;
+
 private:
     float alpha = 1;
     float gamma = 0.75;
-    std::unique_ptr<ActionValue> Q;
+    std::unique_ptr<Table> Q;
+    TraceMode mode = TraceMode::none;
+    float lambda = 0;
+    SparseTraces traces;
+    float delta = 0;
+
+    // One step of SARSA(lambda) or Watkins Q(lambda) with replacing traces
+    void updateTraces(const State& cur, Action curAct, double reward, const State& prev, Action prevAct) {
+        Features f;
+        Q->active(prev, f);
+        for (int t = 0; t < f.count; t++)
+            traces.replace(Q->index(f.idx[t], prevAct));
+
+        double target = reward;
+        bool cut = cur.broken;
+        if (not cur.broken) {
+            auto next = Q->values(cur);
+            if (mode == TraceMode::watkins) {
+                Action best = Table::argmax(next);
+                target += gamma * next[best];
+                cut = next[curAct] < next[best];
+            }
+            else {
+                target += gamma * next[curAct];
+            }
+        }
+        delta = target - Q->value(f, prevAct);
+        float step = alpha * delta / f.count;
+        traces.apply(Q->data(), step, gamma * lambda);
+        if (cut)
+            traces.clear();
+    }
+
 public:
-    Agent(void) {
-        Q = std::make_unique<ActionValue>();
+    BasicAgent(void) {
+        Q = std::make_unique<Table>();
+    }
+
+    BasicAgent(float alpha, float gamma, int tilings = NUM_TILINGS, size_t hashSize = 0): alpha(alpha), gamma(gamma) {
+        Q = std::make_unique<Table>(tilings, hashSize);
     }
 
+    BasicAgent(float alpha, float gamma, std::unique_ptr<Table> Q): alpha(alpha), gamma(gamma), Q(std::move(Q)) {}
+
+    float stepSize(void) const {
+        return alpha;
+    }
+
+    float discount(void) const {
+        return gamma;
+    }
+
+    // Switches between one-step SARSA and the lambda-return methods
+    void setTraces(TraceMode mode, float lambda) {
+        this->mode = mode;
+        this->lambda = lambda;
+        traces.clear();
+    }
+
+    // Traces don't carry over from one episode to the next
+    void beginEpisode(void) {
+        traces.clear();
+    }
+
+    // alpha is shared between the active tiles, so each tiling moves by alpha / tilings
     void updateSarsa(const State& cur, Action curAct, double reward, const State& prev, Action prevAct) {
-        auto weights_to_update = Q->grad(prev, prevAct);
-        for (auto& w : weights_to_update) {
-            if (cur.broken) {
-                *w = *w + alpha * (reward - (*Q)(prev, prevAct));
-            }
-            else {
-                *w = *w + alpha * (reward + gamma * (*Q)(cur, curAct) - (*Q)(prev, prevAct));
-            }
+        if (mode != TraceMode::none) {
+            updateTraces(cur, curAct, reward, prev, prevAct);
+            return;
         }
-        return;
+        Features f;
+        Q->active(prev, f);
+        double target = cur.broken ? reward : reward + gamma * (*Q)(cur, curAct);
+        delta = target - Q->value(f, prevAct);
+        Q->update(f, prevAct, alpha * delta / f.count);
+    }
+
+    // TD error of the last updateSarsa()
+    float tdError(void) const {
+        return delta;
     }
 
     Action greedy(const State& x, double epsilon = 1) {
         return Q->greedy(x, epsilon);
     }
 
+    Table& values(void) {
+        return *Q;
+    }
+
     void print(const State& x, Action a) {
         std::cout << "Q(x, a): " << (*Q)(x,a) << std::endl;
     }
     
-    void dump() {
-        std::ofstream ofs ("data.csv", std::ofstream::out); 
-        ofs << "action, angle, velocity, Q" << std::endl;
+    void dump(const std::string& path = "data.csv") {
+        std::ofstream ofs (path, std::ofstream::out); 
+        ofs << "action, angle, velocity, Q\n";
         std::string actn;
         for (int k = 0; k < NUM_ACTIONS; k++) {
             switch (k) {
@@ -258,10 +521,17 @@ public:
                 actn = "TorqueR";
                 break;
             }
-            for (int i = 0; i < ANGULAR_BUCKETS; i++) 
-                for (int j = 0; j < VELOCITY_BUCKETS; j++) 
-                    ofs << actn << ", " << i << ", " << j << ", " << Q->weight(i,j,k) << std::endl;
+            // Q at the centre of each cell of the base grid
+            for (int i = 0; i < AngleBins; i++) 
+                for (int j = 0; j < VelocityBins; j++) {
+                    State x{(i + 0.5) * 2 * M_PI / AngleBins,
+                            MIN_VELOCITY + (j + 0.5) * (MAX_VELOCITY - MIN_VELOCITY) / VelocityBins,
+                            false, false, false};
+                    ofs << actn << ", " << i << ", " << j << ", " << (*Q)(x, Environment::actions[k]) << '\n';
+                }
         }
     }
 
 };
+
+typedef BasicAgent<> Agent;
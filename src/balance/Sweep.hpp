@@ -0,0 +1,152 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Parallel.hpp"
+
+// Hyperparameter sweeps.  alpha, gamma, EPSILON_C, the tilings and the torques are plain run-time
+// values, but the bucket counts size the tile coder at compile time, so each supported grid is its
+// own instantiation and a job is dispatched to the matching one.  Every job therefore trains with
+// exactly the same constant-folded code as a build with those constants baked in.
+
+constexpr int SWEEP_BUCKETS[] = {25, 50, 100, 200};
+
+struct SweepConfig {
+    double alpha = 1;
+    double gamma = 0.75;
+    double epsC = EPSILON_C;
+    int angleBuckets = ANGULAR_BUCKETS;
+    int velocityBuckets = VELOCITY_BUCKETS;
+    double torque = TORQUE_L;   // applied as +torque left and -torque right
+    int tilings = NUM_TILINGS;
+    uint64_t seed = DEFAULT_SEED;
+};
+
+// Training statistics over one window of episodes, or of the final greedy evaluation
+struct CurvePoint {
+    size_t episode;     // episodes trained so far
+    double length;
+    double ret;
+    double balanced;    // upright for BALANCE_SECONDS in a row
+};
+
+struct SweepResult {
+    SweepConfig config;
+    std::vector<CurvePoint> curve;
+    CurvePoint final;
+    double seconds = 0;
+};
+
+struct SweepSchedule {
+    size_t episodes = 2000;
+    size_t maxSteps = 1000;
+    size_t window = 100;        // episodes per learning-curve point
+    size_t evalEpisodes = 100;
+};
+
+bool supportedBuckets(int n) {
+    for (int b : SWEEP_BUCKETS)
+        if (b == n)
+            return true;
+    return false;
+}
+
+template<int AngleBins, int VelocityBins>
+SweepResult runSweepJob(const SweepConfig& c, const SweepSchedule& s) {
+    SweepResult out;
+    out.config = c;
+    auto start = std::chrono::steady_clock::now();
+
+    seedThread(c.seed);
+    BasicAgent<AngleBins, VelocityBins> agent(c.alpha, c.gamma, c.tilings);
+    TorqueDynamics dynamics{c.torque, -c.torque};
+    size_t step = 0;
+    CurvePoint window{0, 0, 0, 0};
+    size_t inWindow = 0;
+    UprightRun upright;
+    auto watch = [&](const State&, Action, double, const State& x) { upright.observe(x); };
+    for (size_t ep = 0; ep < s.episodes; ep++) {
+        upright = UprightRun();
+        auto stats = runEpisode(agent, randomState(), s.maxSteps, step, c.epsC, watch, dynamics);
+        window.length += stats.decisions;
+        window.ret += stats.ret;
+        window.balanced += upright.balanced();
+        if (++inWindow == s.window or ep + 1 == s.episodes) {
+            out.curve.push_back(CurvePoint{ep + 1, window.length / inWindow, window.ret / inWindow, window.balanced / inWindow});
+            window = CurvePoint{0, 0, 0, 0};
+            inWindow = 0;
+        }
+    }
+
+    // Evaluation starts are shared by every job so configurations are compared on the same states
+    auto q = evaluatePolicy(agent, s.evalEpisodes, s.maxSteps, EVAL_SEED, dynamics);
+    out.final = CurvePoint{s.episodes, q.meanLength, q.meanReturn, q.balanced};
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return out;
+}
+
+// Calls f(integral_constant<int, B>) for the SWEEP_BUCKETS entry equal to n
+template<size_t I = 0, typename F>
+void dispatchBuckets(int n, F&& f) {
+    if constexpr (I < sizeof(SWEEP_BUCKETS) / sizeof(SWEEP_BUCKETS[0])) {
+        if (n == SWEEP_BUCKETS[I])
+            f(std::integral_constant<int, SWEEP_BUCKETS[I]>());
+        else
+            dispatchBuckets<I + 1>(n, f);
+    }
+}
+
+SweepResult runSweepJob(const SweepConfig& c, const SweepSchedule& s) {
+    SweepResult out;
+    dispatchBuckets(c.angleBuckets, [&](auto angle) {
+        dispatchBuckets(c.velocityBuckets, [&](auto velocity) {
+            out = runSweepJob<decltype(angle)::value, decltype(velocity)::value>(c, s);
+        });
+    });
+    return out;
+}
+
+// Runs every job on a pool of threads.  Results come back in job order, and since each job seeds
+// its own thread they don't depend on the thread count.
+std::vector<SweepResult> runSweep(const std::vector<SweepConfig>& jobs, const SweepSchedule& s, int threads,
+                                  bool progress = true) {
+    std::vector<SweepResult> results(jobs.size());
+    std::atomic<size_t> done{0};
+    parallelJobs(threads, jobs.size(), [&](int, size_t i) {
+        results[i] = runSweepJob(jobs[i], s);
+        if (progress)
+            std::fprintf(stderr, "\r%zu/%zu jobs", ++done, jobs.size());
+    });
+    if (progress)
+        std::fprintf(stderr, "\n");
+    return results;
+}
+
+// One CSV for the whole sweep: a curve row per learning-curve window and a final row per job with
+// its greedy evaluation
+bool writeSweepResults(const std::string& path, const std::vector<SweepResult>& results) {
+    std::ofstream ofs(path);
+    if (not ofs) {
+        std::cerr << "Can't write " << path << std::endl;
+        return false;
+    }
+    ofs << "job,alpha,gamma,eps_c,angle_buckets,velocity_buckets,torque,tilings,seed,kind,episode,length,return,balanced\n";
+    for (size_t j = 0; j < results.size(); j++) {
+        const SweepConfig& c = results[j].config;
+        auto row = [&](const char* kind, const CurvePoint& p) {
+            ofs << j << ',' << c.alpha << ',' << c.gamma << ',' << c.epsC << ',' << c.angleBuckets << ','
+                << c.velocityBuckets << ',' << c.torque << ',' << c.tilings << ',' << c.seed << ',' << kind << ','
+                << p.episode << ',' << p.length << ',' << p.ret << ',' << p.balanced << '\n';
+        };
+        for (const CurvePoint& p : results[j].curve)
+            row("curve", p);
+        row("final", results[j].final);
+    }
+    return bool(ofs);
+}
@@ -0,0 +1,264 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "State.hpp"
+
+// In-process counters and histograms for watching training without printing from the hot loop.
+// Every thread that records gets its own cache-line aligned shard, which only that thread writes,
+// so recording is a relaxed load and store with no lock or read-modify-write.  A background thread
+// sums the shards every interval and appends one JSON object per line to a file.
+//
+// Histograms are log-linear: four buckets per power of two for magnitudes from 2^-16 to 2^16 on
+// each side of zero, so percentiles come out within about 12% of the true value whatever the
+// scale of the quantity.
+
+constexpr int MAX_COUNTERS = 16;
+constexpr int MAX_HISTOGRAMS = 8;
+constexpr int HISTOGRAM_MIN_EXP = -16;
+constexpr int HISTOGRAM_MAX_EXP = 16;
+constexpr int HISTOGRAM_SUB = 4;
+constexpr int HISTOGRAM_SIDE = (HISTOGRAM_MAX_EXP - HISTOGRAM_MIN_EXP) * HISTOGRAM_SUB;
+constexpr int HISTOGRAM_BUCKETS = 2 * HISTOGRAM_SIDE + 1;   // negatives, zero, positives
+
+// Bucket of x: the exponent and top two mantissa bits of the double, clamped to the covered range
+inline int histogramBucket(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof bits);
+    int exp = int((bits >> 52) & 0x7ff) - 1023;
+    if (exp < HISTOGRAM_MIN_EXP)
+        return HISTOGRAM_SIDE;
+    int m = std::min((exp - HISTOGRAM_MIN_EXP) * HISTOGRAM_SUB + int((bits >> 50) & 3), HISTOGRAM_SIDE - 1);
+    return (bits >> 63) ? HISTOGRAM_SIDE - 1 - m : HISTOGRAM_SIDE + 1 + m;
+}
+
+// Middle of a bucket, used as the value of every sample that landed in it
+inline double histogramValue(int bucket) {
+    if (bucket == HISTOGRAM_SIDE)
+        return 0;
+    int m = bucket > HISTOGRAM_SIDE ? bucket - HISTOGRAM_SIDE - 1 : HISTOGRAM_SIDE - 1 - bucket;
+    double v = std::ldexp(1 + (m % HISTOGRAM_SUB + 0.5) / HISTOGRAM_SUB, m / HISTOGRAM_SUB + HISTOGRAM_MIN_EXP);
+    return bucket > HISTOGRAM_SIDE ? v : -v;
+}
+
+class Telemetry {
+public:
+    // One thread's accumulators.  Only the owning thread may call add() and record().
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, MAX_COUNTERS> counters{};
+        std::array<std::atomic<double>, MAX_HISTOGRAMS> sums{};
+        std::array<std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS>, MAX_HISTOGRAMS> buckets{};
+
+        void add(int counter, uint64_t n = 1) {
+            auto& c = counters[counter];
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        void record(int histogram, double x) {
+            auto& b = buckets[histogram][histogramBucket(x)];
+            b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            auto& s = sums[histogram];
+            s.store(s.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+        }
+    };
+
+private:
+    std::vector<std::string> counterNames;
+    std::vector<std::string> histogramNames;
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<Shard>> shards;
+    bool stopping = false;
+    std::thread flusher;
+    std::ofstream out;
+    double interval = 1;
+
+    // Totals as of the previous flush, for rates and per-interval histograms, and the totals being
+    // summed now.  start() sizes both sets and flush() swaps them, so flushing never allocates.
+    std::chrono::steady_clock::time_point began, last;
+    std::vector<uint64_t> lastCounters, counters;
+    std::vector<double> lastSums, sums;
+    std::vector<std::array<uint64_t, HISTOGRAM_BUCKETS>> lastBuckets, buckets;
+
+    static double percentile(const std::array<uint64_t, HISTOGRAM_BUCKETS>& h, uint64_t count, double p) {
+        uint64_t rank = uint64_t(p * (count - 1));
+        uint64_t seen = 0;
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            seen += h[b];
+            if (seen > rank)
+                return histogramValue(b);
+        }
+        return 0;
+    }
+
+    // Caller holds m
+    void flush(void) {
+        auto now = std::chrono::steady_clock::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        std::fill(counters.begin(), counters.end(), 0);
+        std::fill(sums.begin(), sums.end(), 0);
+        for (auto& h : buckets)
+            h.fill(0);
+        for (auto& s : shards) {
+            for (size_t c = 0; c < counters.size(); c++)
+                counters[c] += s->counters[c].load(std::memory_order_relaxed);
+            for (size_t h = 0; h < buckets.size(); h++) {
+                sums[h] += s->sums[h].load(std::memory_order_relaxed);
+                for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+                    buckets[h][b] += s->buckets[h][b].load(std::memory_order_relaxed);
+            }
+        }
+
+        out << "{\"time\":" << std::chrono::duration<double>(now - began).count() << ",\"counters\":{";
+        for (size_t c = 0; c < counters.size(); c++)
+            out << (c ? "," : "") << '"' << counterNames[c] << "\":" << counters[c];
+        out << "},\"rates\":{";
+        for (size_t c = 0; c < counters.size(); c++)
+            out << (c ? "," : "") << '"' << counterNames[c] << "_per_s\":" << (dt > 0 ? (counters[c] - lastCounters[c]) / dt : 0);
+        out << "},\"histograms\":{";
+        for (size_t h = 0; h < buckets.size(); h++) {
+            // Only the samples recorded since the last flush
+            std::array<uint64_t, HISTOGRAM_BUCKETS> delta;
+            uint64_t count = 0;
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                delta[b] = buckets[h][b] - lastBuckets[h][b];
+                count += delta[b];
+            }
+            out << (h ? "," : "") << '"' << histogramNames[h] << "\":{\"count\":" << count;
+            if (count)
+                out << ",\"mean\":" << (sums[h] - lastSums[h]) / count
+                    << ",\"p50\":" << percentile(delta, count, 0.5)
+                    << ",\"p90\":" << percentile(delta, count, 0.9)
+                    << ",\"p99\":" << percentile(delta, count, 0.99);
+            out << '}';
+        }
+        out << "}}\n";
+        out.flush();
+
+        lastCounters.swap(counters);
+        lastSums.swap(sums);
+        lastBuckets.swap(buckets);
+    }
+
+public:
+    ~Telemetry() {
+        stop();
+    }
+
+    // Metrics have to be registered before start()
+    int counter(const std::string& name) {
+        if (counterNames.size() == MAX_COUNTERS)
+            return -1;
+        counterNames.push_back(name);
+        return int(counterNames.size()) - 1;
+    }
+
+    int histogram(const std::string& name) {
+        if (histogramNames.size() == MAX_HISTOGRAMS)
+            return -1;
+        histogramNames.push_back(name);
+        return int(histogramNames.size()) - 1;
+    }
+
+    // A new shard for the calling thread.  It lives as long as the Telemetry does.
+    Shard& shard(void) {
+        std::lock_guard<std::mutex> lock(m);
+        shards.push_back(std::make_unique<Shard>());
+        return *shards.back();
+    }
+
+    // Starts flushing to path every interval seconds
+    bool start(const std::string& path, double seconds = 1) {
+        out.open(path);
+        if (not out) {
+            std::cerr << "Can't write " << path << std::endl;
+            return false;
+        }
+        interval = seconds;
+        began = last = std::chrono::steady_clock::now();
+        lastCounters.assign(counterNames.size(), 0);
+        counters.assign(counterNames.size(), 0);
+        lastSums.assign(histogramNames.size(), 0);
+        sums.assign(histogramNames.size(), 0);
+        lastBuckets.resize(histogramNames.size());
+        buckets.resize(histogramNames.size());
+        for (auto& h : lastBuckets)
+            h.fill(0);
+
+        flusher = std::thread([this] {
+            std::unique_lock<std::mutex> lock(m);
+            while (not stopping) {
+                cv.wait_for(lock, std::chrono::duration<double>(interval));
+                flush();
+            }
+        });
+        return true;
+    }
+
+    // Writes a last record and stops the flusher
+    void stop(void) {
+        if (not flusher.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        flusher.join();
+    }
+};
+
+// The metrics the trainers report
+struct TrainingMetrics {
+    Telemetry telemetry;
+    int actions = telemetry.counter("actions");
+    int physicsSteps = telemetry.counter("physics_steps");
+    int episodes = telemetry.counter("episodes");
+    int broken = telemetry.counter("broken");
+    int episodeLength = telemetry.histogram("episode_length");
+    int episodeReturn = telemetry.histogram("return");
+    int tdError = telemetry.histogram("td_error");
+};
+
+// A thread's handle for recording TrainingMetrics, or a no-op without one
+class TrainingProbe {
+private:
+    const TrainingMetrics* metrics = nullptr;
+    Telemetry::Shard* shard = nullptr;
+
+public:
+    TrainingProbe(void) {}
+
+    TrainingProbe(TrainingMetrics* metrics): metrics(metrics), shard(metrics ? &metrics->telemetry.shard() : nullptr) {}
+
+    void action(double tdError) {
+        if (shard == nullptr)
+            return;
+        shard->add(metrics->actions);
+        shard->add(metrics->physicsSteps, PHYSICS_STEPS_PER_ACTION);
+        shard->record(metrics->tdError, tdError);
+    }
+
+    void episode(size_t length, double ret, bool broken) {
+        if (shard == nullptr)
+            return;
+        shard->add(metrics->episodes);
+        shard->add(metrics->broken, broken);
+        shard->record(metrics->episodeLength, double(length));
+        shard->record(metrics->episodeReturn, ret);
+    }
+};
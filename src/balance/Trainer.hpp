@@ -0,0 +1,165 @@
+#pragma once
+#include "State.hpp"
+
+// Exploration schedule from the windowed loop: eps climbs towards 1 (fully greedy) as step grows
+double epsilon(size_t step, double epsC = EPSILON_C) {
+    return 1 - epsC / std::pow(step / 50, 0.5);
+}
+
+// Episodes restart from a random angle at rest, the same as a reset in main()
+State randomState(void) {
+    return State{2 * M_PI * uniform() - M_PI, 0, false, false, false};
+}
+
+// Inside the old reward boundary, the definition of upright that bench's end-to-end run uses
+inline bool upright(const State& x) {
+    double a = angle(x.theta);
+    return a > LEFT_REWARD_BDY and a < RIGHT_REWARD_BDY;
+}
+
+// A policy balances if it keeps the pendulum upright this long without a break.  Never breaking
+// isn't enough: left alone the pendulum swings below MAX_VELOCITY forever.
+constexpr double BALANCE_SECONDS = 10;
+
+// Seed of the greedy evaluation starts, shared by every tool so their scores are comparable
+constexpr uint64_t EVAL_SEED = 12345;
+
+// Runs of consecutive decisions that ended upright and unbroken
+struct UprightRun {
+    uint32_t run = 0;
+    uint32_t longest = 0;
+    uint32_t total = 0;     // decisions that ended upright
+
+    void observe(const State& x) {
+        run = upright(x) and not x.broken ? run + 1 : 0;
+        total += run > 0;
+        longest = std::max(longest, run);
+    }
+
+    bool balanced(double seconds = BALANCE_SECONDS) const {
+        return longest * TIME_BETWEEN_ACTIONS >= seconds;
+    }
+};
+
+struct EpisodeStats {
+    size_t decisions = 0;
+    double ret = 0;
+    bool broken = false;
+};
+
+// Default for runEpisode's per-action hook
+struct NoObserver {
+    void operator() (const State&, Action, double, const State&) {}
+};
+
+// Advances x through one action interval by integrating every physics substep
+struct ExactDynamics {
+    void operator() (State& x) {
+        for (int i = 0; i < PHYSICS_STEPS_PER_ACTION; i++)
+            update(x);
+    }
+};
+
+// ExactDynamics with torques chosen at run time, for sweeping over the motor strength
+struct TorqueDynamics {
+    double torqueL = TORQUE_L;
+    double torqueR = TORQUE_R;
+
+    void operator() (State& x) {
+        for (int i = 0; i < PHYSICS_STEPS_PER_ACTION; i++)
+            update(x, torqueL, torqueR);
+    }
+};
+
+// Runs SARSA from x until the pendulum breaks or maxDecisions actions have been taken.  step is the
+// global decision counter driving the exploration schedule and is advanced in place.  Any type with
+// Agent's beginEpisode(), greedy() and updateSarsa() can be trained.  observe(prev, a, reward, next)
+// is called with every transition after the agent has learned from it, and advance(x) moves the
+// pendulum through each action interval.
+template<typename A, typename Observer = NoObserver, typename Dynamics = ExactDynamics>
+EpisodeStats runEpisode(A& agent, State x, size_t maxDecisions, size_t& step, double epsC = EPSILON_C,
+                        Observer&& observe = Observer(), Dynamics&& advance = Dynamics()) {
+    EpisodeStats stats;
+    agent.beginEpisode();
+    Action a = agent.greedy(x, epsilon(step, epsC));
+
+    while (stats.decisions < maxDecisions) {
+        State lastActionState = x;
+        act(x, a);
+        advance(x);
+
+        step++;
+        stats.decisions++;
+        Action next = agent.greedy(x, epsilon(step, epsC));
+        double reward = Environment::reward(lastActionState, a, x);
+        agent.updateSarsa(x, next, reward, lastActionState, a);
+        observe(lastActionState, a, reward, x);
+        stats.ret += reward;
+        a = next;
+
+        if (x.broken) {
+            stats.broken = true;
+            break;
+        }
+    }
+    return stats;
+}
+
+struct PolicyQuality {
+    double meanLength = 0;
+    double meanReturn = 0;
+    double balanced = 0;    // fraction of episodes upright for BALANCE_SECONDS in a row
+    double upright = 0;     // fraction of the maxSteps decisions per episode spent upright
+    double unbroken = 0;    // fraction of episodes that never broke
+};
+
+struct EpisodeOutcome {
+    uint32_t decisions = 0;
+    UprightRun upright;
+    bool broken = false;
+    double ret = 0;
+};
+
+// One greedy rollout, without learning, from the randomState() drawn from seed.  Episode i of an
+// evaluation uses seed + i, so it starts from the same state whatever ran before it, and
+// greedy(x) with eps = 1 never looks at the random numbers.  Anything with a greedy(state) method
+// can be evaluated.
+template<typename P, typename Dynamics>
+EpisodeOutcome evaluateEpisode(P& policy, uint64_t seed, size_t maxSteps, Dynamics& advance) {
+    seedThread(seed);
+    State x = randomState();
+    EpisodeOutcome out;
+    size_t n = 0;
+    for (; n < maxSteps and not x.broken; n++) {
+        Action a = policy.greedy(x);
+        State before = x;
+        act(x, a);
+        advance(x);
+        out.ret += Environment::reward(before, a, x);
+        out.upright.observe(x);
+    }
+    out.decisions = uint32_t(n);
+    out.broken = x.broken;
+    return out;
+}
+
+// Greedy rollouts of policy from the starts seed, seed + 1, ..., on the calling thread
+template<typename P, typename Dynamics = ExactDynamics>
+PolicyQuality evaluatePolicy(P& policy, size_t episodes, size_t maxSteps, uint64_t seed,
+                             Dynamics&& advance = Dynamics()) {
+    PolicyQuality out;
+    for (size_t ep = 0; ep < episodes; ep++) {
+        EpisodeOutcome o = evaluateEpisode(policy, seed + ep, maxSteps, advance);
+        out.meanLength += o.decisions;
+        out.meanReturn += o.ret;
+        out.balanced += o.upright.balanced();
+        out.upright += o.upright.total;
+        out.unbroken += not o.broken;
+    }
+    out.meanLength /= episodes;
+    out.meanReturn /= episodes;
+    out.balanced /= episodes;
+    out.upright /= double(episodes) * maxSteps;
+    out.unbroken /= episodes;
+    return out;
+}
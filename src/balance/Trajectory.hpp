@@ -0,0 +1,307 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "State.hpp"
+
+// Trajectory files: every action's (step, theta, L, action, reward, broken), delta-encoded against
+// the previous record.  After an 8 byte header ("RMLT" and a version) each record is
+//
+//   flags   bits 0-1 action, bit 2 broken, bit 3 first record of an episode
+//   step    LEB128 varint of the increase since the previous record
+//   theta, L, reward
+//           each the XOR of its bits with a prediction, stored as a control byte (leading zero
+//           bytes << 4 | trailing zero bytes) followed by the bytes in between
+//
+// theta and L are predicted by the previous record's values, which share their sign, exponent and
+// leading mantissa bits.  The reward is predicted by recomputing it from the decoded state and
+// action, which is nearly always exact and leaves a single control byte.  The prediction wraps theta
+// with std::fmod in every build, so a file written by a fast math build, whose angle() is a
+// polynomial, decodes the same in a normal one and the other way round.  Version 1 files predicted
+// with the writing build's own reward, so they only decode correctly in the same math mode.  Records take about 20
+// bytes instead of 33, and decoding is exact, so replaying re-integrates the physics from
+// bit-identical states.  The first record of an episode is its start state with
+// action off and no reward; every later one is the state after that action.
+
+constexpr char TRAJECTORY_MAGIC[4] = {'R', 'M', 'L', 'T'};
+constexpr uint32_t TRAJECTORY_VERSION = 2;
+constexpr size_t TRAJECTORY_MAX_RECORD = 1 + 10 + 3 * 9;
+constexpr size_t TRAJECTORY_BUFFER = 1 << 16;
+
+struct TrajectoryRecord {
+    uint64_t step;
+    double theta;
+    double L;
+    Action action;
+    double reward;
+    bool broken;
+    bool start;
+};
+
+inline uint8_t* putVarint(uint8_t* p, uint64_t x) {
+    while (x >= 0x80) {
+        *p++ = uint8_t(x) | 0x80;
+        x >>= 7;
+    }
+    *p++ = uint8_t(x);
+    return p;
+}
+
+inline uint64_t doubleBits(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof bits);
+    return bits;
+}
+
+// The reward the decoder expects for a record, from its own fields: Environment::reward with
+// the exact fmod wrap of a normal build's angle(), whatever this build's math mode
+inline double predictReward(double theta, double L, Action a, bool start, uint32_t version = TRAJECTORY_VERSION) {
+    if (start)
+        return 0;
+    if (version == 1) {
+        State prev{}, cur{theta, L, false, false, false};
+        return Environment::reward(prev, a, cur);
+    }
+    if (L > MAX_VELOCITY or L < MIN_VELOCITY)
+        return -100;
+    double act = a == Action::torqueL or a == Action::torqueR ? 1 : 0;
+    double t = std::fmod(theta + M_PI, 2 * M_PI);
+    if (t < 0)
+        t += 2 * M_PI;
+    t -= M_PI;
+    return -(t * t + L * L + act);
+}
+
+inline uint8_t* putXor(uint8_t* p, uint64_t bits, uint64_t predicted) {
+    uint64_t d = bits ^ predicted;
+    int lead = d ? __builtin_clzll(d) / 8 : 8;
+    int trail = d ? __builtin_ctzll(d) / 8 : 0;
+    *p++ = uint8_t(lead << 4 | trail);
+    for (int b = 7 - lead; b >= trail; b--)
+        *p++ = uint8_t(d >> (8 * b));
+    return p;
+}
+
+// Encodes records into a pair of buffers.  The simulation thread fills one while a background
+// thread writes the other to disk; if the writer is still busy when the front buffer fills, the
+// front buffer keeps growing rather than making the simulation wait.
+class TrajectoryRecorder {
+private:
+    std::FILE* file = nullptr;
+    std::vector<uint8_t> front, back;
+    std::atomic<bool> backBusy{false};
+    bool closing = false;
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread writer;
+
+    uint64_t lastStep = 0;
+    uint64_t lastTheta = 0, lastL = 0;
+    bool nextStart = false;
+    size_t records = 0;
+    size_t bytes = 0;
+    size_t overflows = 0;
+
+    // Hands the front buffer to the writer if it is free
+    void handOff(void) {
+        if (backBusy.load(std::memory_order_acquire)) {
+            overflows++;
+            return;
+        }
+        std::swap(front, back);
+        front.clear();
+        {
+            std::lock_guard<std::mutex> lock(m);
+            backBusy.store(true, std::memory_order_release);
+        }
+        cv.notify_one();
+    }
+
+public:
+    ~TrajectoryRecorder() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            std::cerr << "Can't write " << path << std::endl;
+            return false;
+        }
+        uint32_t version = TRAJECTORY_VERSION;
+        std::fwrite(TRAJECTORY_MAGIC, 1, sizeof TRAJECTORY_MAGIC, file);
+        std::fwrite(&version, sizeof version, 1, file);
+        front.reserve(TRAJECTORY_BUFFER + TRAJECTORY_MAX_RECORD);
+        back.reserve(TRAJECTORY_BUFFER + TRAJECTORY_MAX_RECORD);
+        writer = std::thread([this] {
+            std::unique_lock<std::mutex> lock(m);
+            while (true) {
+                cv.wait(lock, [&] { return backBusy.load(std::memory_order_acquire) or closing; });
+                if (backBusy.load(std::memory_order_acquire)) {
+                    lock.unlock();
+                    std::fwrite(back.data(), 1, back.size(), file);
+                    lock.lock();
+                    backBusy.store(false, std::memory_order_release);
+                }
+                else if (closing) {
+                    return;
+                }
+            }
+        });
+        return true;
+    }
+
+    bool isOpen(void) const {
+        return file != nullptr;
+    }
+
+    // The pendulum's start state, at the global action count step
+    void beginEpisode(size_t step, const State& x) {
+        nextStart = true;
+        record(step, x, Action::off, 0);
+    }
+
+    // The state reached by taking action a at global action count step, and the reward for it
+    void record(size_t step, const State& x, Action a, double reward) {
+        if (file == nullptr)
+            return;
+        size_t used = front.size();
+        front.resize(used + TRAJECTORY_MAX_RECORD);
+        uint8_t* begin = front.data() + used;
+        uint8_t* p = begin;
+        *p++ = uint8_t(static_cast<int>(a) | x.broken << 2 | nextStart << 3);
+        p = putVarint(p, step - lastStep);
+        uint64_t theta = doubleBits(x.theta), L = doubleBits(x.L);
+        p = putXor(p, theta, lastTheta);
+        p = putXor(p, L, lastL);
+        p = putXor(p, doubleBits(reward), doubleBits(predictReward(x.theta, x.L, a, nextStart)));
+        lastTheta = theta;
+        lastL = L;
+        front.resize(used + (p - begin));
+        lastStep = step;
+        nextStart = false;
+        records++;
+        bytes += p - begin;
+        if (front.size() >= TRAJECTORY_BUFFER)
+            handOff();
+    }
+
+    size_t recorded(void) const {
+        return records;
+    }
+
+    // Encoded bytes, not counting the header
+    size_t size(void) const {
+        return bytes;
+    }
+
+    // Times the writer was still busy with the other buffer when one filled up.  After a stall the
+    // front buffer grows past its reserved size, and that allocates, so recording is only
+    // allocation free while this stays 0.  The grown capacity is kept for the rest of the run.
+    size_t writerStalls(void) const {
+        return overflows;
+    }
+
+    // Writes everything still buffered and closes the file
+    void close(void) {
+        if (file == nullptr)
+            return;
+        // Wait for the writer to finish the back buffer, then write the front one from here
+        {
+            std::unique_lock<std::mutex> lock(m);
+            closing = true;
+        }
+        cv.notify_one();
+        writer.join();
+        if (backBusy.load())
+            std::fwrite(back.data(), 1, back.size(), file);
+        std::fwrite(front.data(), 1, front.size(), file);
+        std::fclose(file);
+        file = nullptr;
+    }
+};
+
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& x) {
+    x = 0;
+    for (int shift = 0; p < end and shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        x |= uint64_t(b & 0x7f) << shift;
+        if (not (b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline bool getXor(const uint8_t*& p, const uint8_t* end, uint64_t predicted, double& x) {
+    if (p == end)
+        return false;
+    int lead = *p >> 4;
+    int trail = *p & 0xf;
+    p++;
+    if (lead > 8 or trail > 8 or (lead < 8 and lead + trail > 8) or end - p < 8 - lead - trail)
+        return false;
+    uint64_t d = 0;
+    for (int b = 7 - lead; b >= trail; b--)
+        d |= uint64_t(*p++) << (8 * b);
+    predicted ^= d;
+    std::memcpy(&x, &predicted, sizeof x);
+    return true;
+}
+
+// Decodes a whole trajectory file.  A truncated final record, as left by a crash, is dropped.
+bool readTrajectory(const std::string& path, std::vector<TrajectoryRecord>& out) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "Can't open " << path << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof chunk, file)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    std::fclose(file);
+
+    uint32_t version;
+    if (data.size() < 8 or std::memcmp(data.data(), TRAJECTORY_MAGIC, 4) != 0) {
+        std::cerr << path << " is not a trajectory file" << std::endl;
+        return false;
+    }
+    std::memcpy(&version, data.data() + 4, sizeof version);
+    if (version != 1 and version != TRAJECTORY_VERSION) {
+        std::cerr << path << " has trajectory version " << version << ", expected " << TRAJECTORY_VERSION << std::endl;
+        return false;
+    }
+
+    const uint8_t* p = data.data() + 8;
+    const uint8_t* end = data.data() + data.size();
+    uint64_t step = 0;
+    double theta = 0, L = 0;
+    out.clear();
+    while (p < end) {
+        TrajectoryRecord r;
+        uint8_t flags = *p++;
+        r.action = static_cast<Action>(flags & 3);
+        r.broken = flags & 4;
+        r.start = flags & 8;
+        uint64_t dStep;
+        if (not getVarint(p, end, dStep) or not getXor(p, end, doubleBits(theta), r.theta)
+            or not getXor(p, end, doubleBits(L), r.L)
+            or not getXor(p, end, doubleBits(predictReward(r.theta, r.L, r.action, r.start, version)), r.reward))
+            break;
+        step += dStep;
+        r.step = step;
+        theta = r.theta;
+        L = r.L;
+        out.push_back(r);
+    }
+    return true;
+}
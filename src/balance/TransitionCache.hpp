@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "State.hpp"
+#include "BatchEnv.hpp"
+
+// Replaces the PHYSICS_STEPS_PER_ACTION substeps of an action interval with one table lookup.  The
+// state reached after a full interval is tabulated on a grid of (theta, L) for each net torque, and
+// states between grid points are bilinearly interpolated.  Grid nodes are either all computed up
+// front with precompute() or integrated the first time a lookup needs them.
+//
+// The table stores the change in angle rather than the final angle, so that theta keeps growing
+// continuously like it does under update(), and is periodic in theta.  Momenta outside
+// [MIN_VELOCITY, MAX_VELOCITY], where the pendulum is broken anyway, fall back to exact integration.
+
+constexpr int CACHE_ANGLE_POINTS = 1024;
+constexpr int CACHE_VELOCITY_POINTS = 1024;
+
+class TransitionCache {
+private:
+    // act() can leave both torques on, which cancel out, so only three net torques are possible
+    static constexpr int TORQUES = 3;
+    static constexpr double ANGLE_STEP = 2 * M_PI / CACHE_ANGLE_POINTS;
+    static constexpr double VELOCITY_STEP = (MAX_VELOCITY - MIN_VELOCITY) / (CACHE_VELOCITY_POINTS - 1);
+
+    struct Node {
+        double dTheta;
+        double L;
+    };
+    std::vector<Node> nodes;
+    std::vector<uint8_t> ready;
+
+    static int torqueIdx(const State& x) {
+        if (x.tl_on == x.tr_on)
+            return 0;
+        return x.tl_on ? 1 : 2;
+    }
+
+    static size_t nodeIdx(int t, size_t i, size_t j) {
+        return (size_t(t) * CACHE_VELOCITY_POINTS + j) * CACHE_ANGLE_POINTS + i;
+    }
+
+    static State nodeState(int t, size_t i, size_t j) {
+        return State{i * ANGLE_STEP, MIN_VELOCITY + j * VELOCITY_STEP, t == 1, t == 2, false};
+    }
+
+    const Node& node(int t, size_t i, size_t j) {
+        size_t k = nodeIdx(t, i, j);
+        if (not ready[k]) {
+            State x = nodeState(t, i, j);
+            for (int s = 0; s < PHYSICS_STEPS_PER_ACTION; s++)
+                update(x);
+            nodes[k] = Node{x.theta - i * ANGLE_STEP, x.L};
+            ready[k] = 1;
+        }
+        return nodes[k];
+    }
+
+public:
+    TransitionCache(void):
+        nodes(size_t(TORQUES) * CACHE_ANGLE_POINTS * CACHE_VELOCITY_POINTS),
+        ready(nodes.size(), 0) {}
+
+    // Integrates every grid node, one row of angles at a time as a batch
+    void precompute(void) {
+        BatchEnvironment batch(CACHE_ANGLE_POINTS);
+        for (int t = 0; t < TORQUES; t++) {
+            for (size_t j = 0; j < CACHE_VELOCITY_POINTS; j++) {
+                for (size_t i = 0; i < CACHE_ANGLE_POINTS; i++)
+                    batch.set(i, nodeState(t, i, j));
+                batch.update(PHYSICS_STEPS_PER_ACTION);
+                for (size_t i = 0; i < CACHE_ANGLE_POINTS; i++) {
+                    nodes[ nodeIdx(t, i, j) ] = Node{batch.theta[i] - i * ANGLE_STEP, batch.L[i]};
+                    ready[ nodeIdx(t, i, j) ] = 1;
+                }
+            }
+        }
+    }
+
+    // Fraction of grid nodes computed so far
+    double coverage(void) const {
+        size_t n = 0;
+        for (auto r : ready)
+            n += r;
+        return double(n) / ready.size();
+    }
+
+    size_t bytes(void) const {
+        return nodes.size() * (sizeof(Node) + 1);
+    }
+
+    // Same effect as PHYSICS_STEPS_PER_ACTION calls to update(x), to within interpolation error
+    void operator() (State& x) {
+        double v = (x.L - MIN_VELOCITY) / VELOCITY_STEP;
+        if (not (v >= 0 and v < CACHE_VELOCITY_POINTS - 1)) {
+            for (int s = 0; s < PHYSICS_STEPS_PER_ACTION; s++)
+                update(x);
+            return;
+        }
+        double a = angle2pi(x.theta) / ANGLE_STEP;
+        size_t i = std::min<size_t>(a, CACHE_ANGLE_POINTS - 1);
+        size_t j = v;
+        size_t i1 = (i + 1 == CACHE_ANGLE_POINTS) ? 0 : i + 1;
+        double fa = a - i;
+        double fv = v - j;
+        int t = torqueIdx(x);
+
+        const Node& n00 = node(t, i, j);
+        const Node& n10 = node(t, i1, j);
+        const Node& n01 = node(t, i, j + 1);
+        const Node& n11 = node(t, i1, j + 1);
+        double w00 = (1 - fa) * (1 - fv), w10 = fa * (1 - fv), w01 = (1 - fa) * fv, w11 = fa * fv;
+
+        x.theta += w00 * n00.dTheta + w10 * n10.dTheta + w01 * n01.dTheta + w11 * n11.dTheta;
+        x.L = w00 * n00.L + w10 * n10.L + w01 * n01.L + w11 * n11.L;
+#ifdef BALANCE_FAST_MATH
+        x.theta = wrapAngle(x.theta);
+#endif
+    }
+};
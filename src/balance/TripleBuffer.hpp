@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+// Lock-free handoff of the latest value from one writer thread to one reader thread.  There are
+// three slots: the writer fills its back slot and swaps it with the middle one, and the reader swaps
+// the middle slot into its front slot whenever a fresh one is waiting.  Neither side ever waits for
+// the other; the reader just sees the newest value published so far, and intermediate values the
+// reader was too slow for are skipped.
+template<typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t FRESH = 4;     // set on the middle index when it holds unread data
+
+    T slots[3];
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back = 0;           // writer's slot
+    alignas(64) uint8_t front = 2;          // reader's slot
+
+public:
+    TripleBuffer(const T& initial = T()) {
+        for (T& s : slots)
+            s = initial;
+    }
+
+    // Constructs every slot from args, for values that can't be copied
+    template<typename... Args>
+    TripleBuffer(std::in_place_t, const Args&... args): slots{T(args...), T(args...), T(args...)} {}
+
+    // Writer only: the slot to fill before publish()
+    T& write(void) {
+        return slots[back];
+    }
+
+    void publish(void) {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    // Reader only: the newest published value.  Stays valid until the next call.
+    const T& read(void) {
+        if (middle.load(std::memory_order_relaxed) & FRESH)
+            front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+        return slots[front];
+    }
+};
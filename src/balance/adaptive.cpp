@@ -0,0 +1,99 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "AdaptiveValue.hpp"
+
+// Trains the adaptive kd-tree value function and the tile-coded grid on the same episodes, and
+// compares their greedy policies, their memory, and how finely the tree resolves the balance point.
+// From randomState() alone the pendulum spends over 99% of training hanging down, so by default
+// half the episodes start within 0.3 rad of upright instead.
+
+// The fixed grid the tree's resolution is measured against
+constexpr int REFERENCE_GRID = 1000;
+
+constexpr double UPRIGHT_START_ANGLE = 0.3;
+
+State startState(double upright) {
+    if (uniform() < upright)
+        return State{UPRIGHT_START_ANGLE * (2 * uniform() - 1), 0, false, false, false};
+    return randomState();
+}
+
+template<typename A>
+double train(A& agent, size_t episodes, size_t maxSteps, double epsC, double upright, uint64_t seed) {
+    seedThread(seed);
+    size_t step = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t ep = 0; ep < episodes; ep++)
+        runEpisode(agent, startState(upright), maxSteps, step, epsC);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& name, const PolicyQuality& q, double seconds, size_t bytes) {
+    std::cout << name << " training (s): " << seconds << "\n"
+              << name << " bytes: " << bytes << "\n"
+              << name << " greedy mean length: " << q.meanLength << "\n"
+              << name << " greedy mean return: " << q.meanReturn << "\n"
+              << name << " greedy balanced fraction: " << q.balanced << "\n"
+              << name << " greedy upright fraction: " << q.upright << "\n"
+              << name << " greedy unbroken fraction: " << q.unbroken << "\n";
+}
+
+int main(int argc, char** argv) {
+    size_t episodes = 10000;
+    size_t maxSteps = 1000;
+    double epsC = EPSILON_C;
+    float alpha = 0.2f;
+    double upright = 0.5;
+    AdaptiveConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--episodes" and hasValue)
+            episodes = std::stoul(argv[++i]);
+        else if (arg == "--max-steps" and hasValue)
+            maxSteps = std::stoul(argv[++i]);
+        else if (arg == "--epsilon" and hasValue)
+            epsC = std::stod(argv[++i]);
+        else if (arg == "--alpha" and hasValue)
+            alpha = std::stof(argv[++i]);
+        else if (arg == "--upright-starts" and hasValue)
+            upright = std::stod(argv[++i]);
+        else if (arg == "--max-leaves" and hasValue)
+            config.maxLeaves = std::stoul(argv[++i]);
+        else if (arg == "--split-visits" and hasValue)
+            config.splitVisits = std::stoul(argv[++i]);
+        else if (arg == "--variance" and hasValue)
+            config.varianceThreshold = std::stof(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--episodes N] [--max-steps N] [--epsilon C] [--alpha X] [--upright-starts FRACTION]\n"
+                      << "       [--max-leaves N] [--split-visits N] [--variance X]" << std::endl;
+            return 1;
+        }
+    }
+
+    AdaptiveAgent tree(alpha, 0.75f, config);
+    double treeSeconds = train(tree, episodes, maxSteps, epsC, upright, 1);
+    AdaptiveValue& Q = tree.values();
+    Q.compact();
+    auto treeQuality = evaluatePolicy(tree, 1000, maxSteps, EVAL_SEED);
+
+    Agent grid;
+    double gridSeconds = train(grid, episodes, maxSteps, epsC, upright, 1);
+    auto gridQuality = evaluatePolicy(grid, 1000, maxSteps, EVAL_SEED);
+
+    // Resolution at upright and at rest, the state the policy is trying to hold
+    AdaptiveValue::Cell c = Q.cell(Q.leaf(State{0, 0, false, false, false}));
+    size_t referenceBytes = size_t(REFERENCE_GRID) * REFERENCE_GRID * sizeof(AdaptiveValue::Values);
+    std::cout << "Leaves: " << Q.leaves() << " (" << Q.splitCount() << " splits)\n"
+              << "Balance cell: angle " << c.angleHi - c.angleLo << " x momentum " << c.LHi - c.LLo << "\n"
+              << REFERENCE_GRID << "x" << REFERENCE_GRID << " grid cell: angle " << 2 * M_PI / REFERENCE_GRID
+              << " x momentum " << (MAX_VELOCITY - MIN_VELOCITY) / REFERENCE_GRID << "\n"
+              << "Tree bytes: " << Q.bytes() << " (+" << Q.trainingBytes() << " while training), "
+              << REFERENCE_GRID << "x" << REFERENCE_GRID << " grid bytes: " << referenceBytes << "\n";
+    report("Tree", treeQuality, treeSeconds, Q.bytes());
+    report("Grid", gridQuality, gridSeconds, grid.values().size() * sizeof(float));
+    return 0;
+}
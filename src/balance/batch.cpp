@@ -0,0 +1,91 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include<vector>
+#include "State.hpp"
+#include "BatchEnv.hpp"
+
+// Steps a batch of pendulums with BatchEnvironment and with the scalar update(), reports the
+// throughput of each, and checks that they agree to within BATCH_TOLERANCE.
+
+int main(int argc, char** argv) {
+    size_t envs = 4096;
+    size_t actions = 100;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--envs" and i + 1 < argc)
+            envs = std::stoul(argv[++i]);
+        else if (arg == "--actions" and i + 1 < argc)
+            actions = std::stoul(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--envs N] [--actions N]" << std::endl;
+            return 1;
+        }
+    }
+
+    seedThread(0);
+    BatchRng noise(1);
+    std::vector<double> u(envs);
+    std::vector<State> scalar(envs);
+    std::vector<Action> chosen(envs);
+    std::vector<double> rewards(envs);
+    BatchEnvironment batch(envs);
+    for (size_t i = 0; i < envs; i++) {
+        scalar[i] = State{2 * M_PI * uniform() - M_PI, 4 * uniform() - 2, false, false, false};
+        batch.set(i, scalar[i]);
+    }
+
+    double maxErr = 0;
+    size_t brokenMismatches = 0;    // one kernel broke the pendulum and the other didn't
+    double scalarTime = 0, batchTime = 0;
+    for (size_t k = 0; k < actions; k++) {
+        noise.fill(u.data(), envs);
+        for (size_t i = 0; i < envs; i++)
+            chosen[i] = Environment::actions[int(u[i] * NUM_ACTIONS)];
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < envs; i++) {
+            if (scalar[i].broken)
+                continue;
+            act(scalar[i], chosen[i]);
+            for (int s = 0; s < PHYSICS_STEPS_PER_ACTION; s++)
+                update(scalar[i]);
+            Environment::reward(scalar[i], chosen[i], scalar[i]);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        batch.act(chosen.data());
+        batch.update(PHYSICS_STEPS_PER_ACTION);
+        batch.reward(chosen.data(), rewards.data());
+        auto t2 = std::chrono::steady_clock::now();
+
+        scalarTime += std::chrono::duration<double>(t1 - t0).count();
+        batchTime += std::chrono::duration<double>(t2 - t1).count();
+
+        // Compare, then resync so every interval is checked from identical starting points
+        for (size_t i = 0; i < envs; i++) {
+            if (scalar[i].broken != bool(batch.broken[i])) {
+                brokenMismatches++;
+                scalar[i].broken = true;
+                batch.broken[i] = true;
+                continue;
+            }
+            maxErr = std::max(maxErr, std::abs(angle(scalar[i].theta - batch.theta[i])));
+            maxErr = std::max(maxErr, std::abs(scalar[i].L - batch.L[i]));
+            batch.set(i, scalar[i]);
+        }
+    }
+
+    double substeps = double(envs) * actions * PHYSICS_STEPS_PER_ACTION;
+    std::cout << "Environments: " << envs << "\n"
+#ifdef __AVX__
+              << "Kernel: AVX\n"
+#else
+              << "Kernel: scalar\n"
+#endif
+              << "Scalar physics steps/s: " << substeps / scalarTime << "\n"
+              << "Batched physics steps/s: " << substeps / batchTime << "\n"
+              << "Speedup: " << scalarTime / batchTime << "\n"
+              << "Max deviation per action: " << maxErr << " (tolerance " << BATCH_TOLERANCE << ")\n"
+              << "Broken state mismatches: " << brokenMismatches << std::endl;
+    return maxErr <= BATCH_TOLERANCE and brokenMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include<vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Policy.hpp"
+#include "AdaptiveValue.hpp"
+#include "Quantized.hpp"
+
+// Benchmarks for the pieces of the RL loop and for training end to end.  Results are printed as
+// CSV, one row per benchmark, so runs from different commits can be compared mechanically.
+
+// Stops the compiler from optimizing away a result we never use
+template<typename T>
+void keep(const T& x) {
+    asm volatile("" : : "g"(&x) : "memory");
+}
+
+// Calls f in a loop, growing the iteration count until the loop takes at least minSeconds
+template<typename F>
+void measure(const std::string& name, F f, double minSeconds = 0.2) {
+    size_t iterations = 1;
+    double seconds = 0;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            f(i);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds >= minSeconds)
+            break;
+        iterations *= seconds > 0 ? std::max<size_t>(2, std::min<size_t>(100, minSeconds / seconds * 1.2)) : 100;
+    }
+    std::cout << name << "," << iterations << "," << seconds << "," << seconds * 1e9 / iterations << std::endl;
+}
+
+// Precomputed inputs, so the benchmarks time the code under test and not the random number generator
+constexpr size_t INPUTS = 4096;
+
+// Lookups in an adaptive tree grown by a short run of training
+void adaptiveBenchmark(const std::vector<State>& states) {
+    AdaptiveAgent tree;
+    size_t step = 0;
+    for (int ep = 0; ep < 200; ep++)
+        runEpisode(tree, randomState(), 200, step);
+    tree.values().compact();
+    measure("adaptive_value", [&](size_t i) {
+        keep(tree.values().values(states[i % INPUTS]));
+    });
+}
+
+void quantizedBenchmark(const std::vector<State>& states, const std::vector<Action>& actions, const ActionValue<>& Q) {
+    QuantizedValue<WeightFormat::f16> half(Q);
+    QuantizedValue<WeightFormat::i8> byte(Q);
+    measure("fp16_values", [&](size_t i) {
+        keep(half.values(states[i % INPUTS]));
+    });
+    measure("int8_values", [&](size_t i) {
+        keep(byte.values(states[i % INPUTS]));
+    });
+    measure("int8_update", [&](size_t i) {
+        Features f;
+        byte.active(states[i % INPUTS], f);
+        byte.update(f, actions[i % INPUTS], 0.01f);
+    });
+}
+
+void microbenchmarks(void) {
+    std::vector<State> states(INPUTS);
+    std::vector<Action> actions(INPUTS);
+    for (size_t i = 0; i < INPUTS; i++) {
+        states[i] = State{2 * M_PI * uniform() - M_PI, 20 * uniform() - 10, false, false, false};
+        actions[i] = static_cast<Action>(uniformInt(0, NUM_ACTIONS));
+    }
+
+    // Train a little so the table isn't all zeros
+    Agent Bond;
+    size_t step = 0;
+    for (int ep = 0; ep < 200; ep++)
+        runEpisode(Bond, randomState(), 200, step);
+    ActionValue<>& Q = Bond.values();
+
+    measure("update", [&](size_t i) {
+        State x = states[i % INPUTS];
+        update(x);
+        keep(x);
+    });
+    measure("reward", [&](size_t i) {
+        State cur = states[i % INPUTS];
+        keep(Environment::reward(states[(i + 1) % INPUTS], actions[i % INPUTS], cur));
+    });
+    measure("angle", [&](size_t i) {
+        keep(angle(states[i % INPUTS].theta));
+    });
+    measure("angle2pi", [&](size_t i) {
+        keep(angle2pi(states[i % INPUTS].theta));
+    });
+    measure("std_sin", [&](size_t i) {
+        keep(std::sin(states[i % INPUTS].theta));
+    });
+    measure("fast_sin", [&](size_t i) {
+        keep(fastSin(states[i % INPUTS].theta));
+    });
+    measure("actionvalue", [&](size_t i) {
+        keep(Q(states[i % INPUTS], actions[i % INPUTS]));
+    });
+    measure("greedy", [&](size_t i) {
+        keep(Q.greedy(states[i % INPUTS]));
+    });
+    PackedPolicy policy(Q);
+    std::vector<double> theta(INPUTS), L(INPUTS);
+    for (size_t i = 0; i < INPUTS; i++) {
+        theta[i] = states[i].theta;
+        L[i] = states[i].L;
+    }
+    measure("packed_policy", [&](size_t i) {
+        keep(policy.greedy(states[i % INPUTS]));
+    });
+    // One call looks up 64 states
+    Action batch[64];
+    measure("packed_policy_batch64", [&](size_t i) {
+        size_t k = i * 64 % INPUTS;
+        policy.greedy(theta.data() + k, L.data() + k, batch, 64);
+        keep(batch);
+    });
+    adaptiveBenchmark(states);
+    quantizedBenchmark(states, actions, Q);
+    measure("update_sarsa", [&](size_t i) {
+        Bond.updateSarsa(states[(i + 1) % INPUTS], actions[(i + 1) % INPUTS], -1, states[i % INPUTS], actions[i % INPUTS]);
+    });
+    measure("dump", [&](size_t) {
+        Bond.dump("/dev/null");
+    }, 1.0);
+}
+
+// Trains from scratch until the pole first stays within the old reward boundary (+/- pi/12) for
+// balanceSeconds of simulated time.  The longest balanced stretch is reported too, so there's still a
+// number to track while the agent can't reach the target.
+void endToEnd(double balanceSeconds, size_t maxEpisodes) {
+    Agent Bond;
+    size_t step = 0;
+    double balanced = 0;
+    double longest = 0;
+    double firstBalanced = -1;
+    auto start = std::chrono::steady_clock::now();
+
+    auto watch = [&](const State&, Action, double, const State& x) {
+        double a = angle(x.theta);
+        balanced = (a > LEFT_REWARD_BDY and a < RIGHT_REWARD_BDY) ? balanced + TIME_BETWEEN_ACTIONS : 0;
+        longest = std::max(longest, balanced);
+        if (firstBalanced < 0 and balanced >= balanceSeconds)
+            firstBalanced = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    size_t ep = 0;
+    for (; ep < maxEpisodes and firstBalanced < 0; ep++) {
+        balanced = 0;
+        runEpisode(Bond, randomState(), 1000, step, EPSILON_C, watch);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double physSteps = double(step) * PHYSICS_STEPS_PER_ACTION;
+
+    std::cout << "e2e_physics_steps_per_s," << physSteps << "," << seconds << "," << physSteps / seconds << "\n"
+              << "e2e_actions_per_s," << step << "," << seconds << "," << step / seconds << "\n"
+              << "e2e_longest_balance_s," << ep << "," << seconds << "," << longest << "\n"
+              << "e2e_seconds_to_balance_" << balanceSeconds << "s," << ep << "," << seconds << "," << firstBalanced << std::endl;
+}
+
+int main(int argc, char** argv) {
+    double balanceSeconds = 10;
+    size_t maxEpisodes = 5000;
+    bool micro = true, e2e = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--balance-seconds" and i + 1 < argc)
+            balanceSeconds = std::stod(argv[++i]);
+        else if (arg == "--max-episodes" and i + 1 < argc)
+            maxEpisodes = std::stoul(argv[++i]);
+        else if (arg == "--micro")
+            e2e = false;
+        else if (arg == "--e2e")
+            micro = false;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--micro | --e2e] [--balance-seconds T] [--max-episodes N]" << std::endl;
+            return 1;
+        }
+    }
+
+    seedThread(0);
+    // For microbenchmarks the last column is ns per call.  For end to end rows it's the rate, or the
+    // wall time until the agent first balanced (-1 if it never did).
+    std::cout << "benchmark,iterations,seconds,value" << std::endl;
+    if (micro)
+        microbenchmarks();
+    if (e2e)
+        endToEnd(balanceSeconds, maxEpisodes);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "TransitionCache.hpp"
+
+// Measures how far TransitionCache strays from exact integration over one action interval, and how
+// much faster training runs with it
+
+double since(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+int main(int argc, char** argv) {
+    size_t samples = 100000;
+    size_t episodes = 2000;
+    bool lazy = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--samples" and i + 1 < argc)
+            samples = std::stoul(argv[++i]);
+        else if (arg == "--episodes" and i + 1 < argc)
+            episodes = std::stoul(argv[++i]);
+        else if (arg == "--lazy")
+            lazy = true;
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--samples N] [--episodes N] [--lazy]" << std::endl;
+            return 1;
+        }
+    }
+
+    TransitionCache cache;
+    auto t0 = std::chrono::steady_clock::now();
+    if (not lazy)
+        cache.precompute();
+    double buildTime = since(t0);
+
+    // Error over one interval from random states in the cached range
+    seedThread(1);
+    double maxTheta = 0, maxL = 0, sumTheta = 0, sumL = 0;
+    for (size_t k = 0; k < samples; k++) {
+        State exact{2 * M_PI * uniform() - M_PI, MIN_VELOCITY + (MAX_VELOCITY - MIN_VELOCITY) * uniform(), false, false, false};
+        act(exact, static_cast<Action>(uniformInt(0, NUM_ACTIONS)));
+        State cached = exact;
+        ExactDynamics()(exact);
+        cache(cached);
+        double dTheta = std::abs(angle(exact.theta - cached.theta));
+        double dL = std::abs(exact.L - cached.L);
+        maxTheta = std::max(maxTheta, dTheta);
+        maxL = std::max(maxL, dL);
+        sumTheta += dTheta;
+        sumL += dL;
+    }
+
+    // Same training run both ways
+    seedThread(0);
+    Agent exactAgent;
+    size_t step = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (size_t ep = 0; ep < episodes; ep++)
+        runEpisode(exactAgent, randomState(), 500, step);
+    double exactTime = since(t0);
+    size_t exactSteps = step;
+
+    seedThread(0);
+    Agent cachedAgent;
+    step = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (size_t ep = 0; ep < episodes; ep++)
+        runEpisode(cachedAgent, randomState(), 500, step, EPSILON_C, NoObserver(), cache);
+    double cachedTime = since(t0);
+
+    std::cout << "Grid: " << CACHE_ANGLE_POINTS << " x " << CACHE_VELOCITY_POINTS << " x 3 torques, "
+              << cache.bytes() / (1 << 20) << " MiB\n"
+              << (lazy ? "Lazy, nodes filled: " : "Precompute (s): ") << (lazy ? cache.coverage() : buildTime) << "\n"
+              << "Theta error per action: max " << maxTheta << ", mean " << sumTheta / samples << "\n"
+              << "L error per action: max " << maxL << ", mean " << sumL / samples << "\n"
+              << "Exact episodes/s: " << episodes / exactTime << " (" << exactSteps << " actions)\n"
+              << "Cached episodes/s: " << episodes / cachedTime << " (" << step << " actions)\n"
+              << "Speedup: " << exactTime / cachedTime << std::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include<vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Checkpoint.hpp"
+#include "Policy.hpp"
+
+// Compiles a checkpoint's greedy policy into a packed 2 bit per cell table, checks it against the
+// action values it came from and times both
+
+constexpr size_t CHECK_STATES = 1 << 20;
+
+// argmax Q without ActionValue::greedy's exploration draw, so both policies see the same starts
+struct TablePolicy {
+    const ActionValue<>& Q;
+
+    Action greedy(const State& x) const {
+        return Q.argmax(Q.values(x));
+    }
+};
+
+template<typename F>
+double nsPerState(F f, size_t states) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / states;
+}
+
+int main(int argc, char** argv) {
+    std::string ckptPath, policyPath;
+    int subdivisions = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--subdivisions" and i + 1 < argc)
+            subdivisions = std::stoi(argv[++i]);
+        else if (ckptPath.empty())
+            ckptPath = arg;
+        else if (policyPath.empty())
+            policyPath = arg;
+        else
+            policyPath.clear(), ckptPath.clear(), i = argc;
+    }
+    if (ckptPath.empty() or policyPath.empty()) {
+        std::cerr << "Usage: " << argv[0] << " CHECKPOINT POLICY [--subdivisions N (default: exact, one per tiling)]" << std::endl;
+        return 1;
+    }
+
+    auto ckpt = loadCheckpoint(ckptPath);
+    if (ckpt.agent == nullptr)
+        return 1;
+    ActionValue<>& Q = ckpt.agent->values();
+
+    auto t0 = std::chrono::steady_clock::now();
+    PackedPolicy compiled(Q, subdivisions);
+    double compileSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (not compiled.save(policyPath))
+        return 1;
+    PackedPolicy policy;
+    if (not policy.load(policyPath))
+        return 1;
+
+    // Uniform states over the whole table, including velocities past the edges
+    seedThread(DEFAULT_SEED);
+    std::vector<double> theta(CHECK_STATES), L(CHECK_STATES);
+    for (size_t k = 0; k < CHECK_STATES; k++) {
+        theta[k] = 4 * M_PI * uniform() - 2 * M_PI;
+        L[k] = 24 * uniform() - 12;
+    }
+    std::vector<Action> fromQ(CHECK_STATES), single(CHECK_STATES), batched(CHECK_STATES);
+
+    double qNs = nsPerState([&] {
+        for (size_t k = 0; k < CHECK_STATES; k++)
+            fromQ[k] = Q.argmax(Q.values(State{theta[k], L[k], false, false, false}));
+    }, CHECK_STATES);
+    double singleNs = nsPerState([&] {
+        for (size_t k = 0; k < CHECK_STATES; k++)
+            single[k] = policy(theta[k], L[k]);
+    }, CHECK_STATES);
+    double batchNs = nsPerState([&] {
+        policy.greedy(theta.data(), L.data(), batched.data(), CHECK_STATES);
+    }, CHECK_STATES);
+
+    size_t agree = 0, batchAgree = 0;
+    for (size_t k = 0; k < CHECK_STATES; k++) {
+        agree += single[k] == fromQ[k];
+        batchAgree += batched[k] == single[k];
+    }
+
+    TablePolicy table{Q};
+    auto fromTable = evaluatePolicy(table, 1000, 1000, EVAL_SEED);
+    auto fromPolicy = evaluatePolicy(policy, 1000, 1000, EVAL_SEED);
+
+    std::cout << "Cells: " << policy.size() << "\n"
+              << "Policy bytes: " << policy.bytes() << " (Q table " << Q.size() * sizeof(float) << ")\n"
+              << "Compile time (s): " << compileSeconds << "\n"
+              << "Disagreements with argmax Q: " << CHECK_STATES - agree << " of " << CHECK_STATES << "\n"
+              << "Batched lookups differing from single: " << CHECK_STATES - batchAgree << "\n"
+              << "Q argmax (ns/state): " << qNs << "\n"
+              << "Packed lookup (ns/state): " << singleNs << "\n"
+              << "Packed batch (ns/state): " << batchNs << "\n"
+              << "Greedy Q mean length / return: " << fromTable.meanLength << " / " << fromTable.meanReturn << "\n"
+              << "Packed mean length / return: " << fromPolicy.meanLength << " / " << fromPolicy.meanReturn << std::endl;
+    return batchAgree == CHECK_STATES ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include "State.hpp"
+#include "Checkpoint.hpp"
+#include "Evaluate.hpp"
+
+// Evaluates a checkpoint's greedy policy on every core and optionally gates on the result, for
+// deciding whether a model gets promoted.  --min-balanced gates on the fraction of episodes that
+// held the pendulum upright for --balance-seconds (default 10) in a row.  --check reruns on one
+// thread and fails unless every outcome matches.  Exits 1 on errors and 2 if a gate isn't met.
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " CHECKPOINT [--episodes M] [--max-steps N] [--seed S] [--threads T] [--check]\n"
+              << "       [--balance-seconds T] [--min-balanced FRACTION] [--min-return R]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    EvaluationConfig config;
+    bool check = false;
+    bool gateBalanced = false, gateReturn = false;
+    double minBalanced = 0, minReturn = 0;
+    std::string path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--episodes" and hasValue)
+            config.episodes = std::stoul(argv[++i]);
+        else if (arg == "--max-steps" and hasValue)
+            config.maxSteps = std::stoul(argv[++i]);
+        else if (arg == "--seed" and hasValue)
+            config.seed = std::stoull(argv[++i]);
+        else if (arg == "--threads" and hasValue)
+            config.threads = std::stoi(argv[++i]);
+        else if (arg == "--balance-seconds" and hasValue)
+            config.balanceSeconds = std::stod(argv[++i]);
+        else if (arg == "--check")
+            check = true;
+        else if (arg == "--min-balanced" and hasValue) {
+            gateBalanced = true;
+            minBalanced = std::stod(argv[++i]);
+        }
+        else if (arg == "--min-return" and hasValue) {
+            gateReturn = true;
+            minReturn = std::stod(argv[++i]);
+        }
+        else if (path.empty() and arg[0] != '-')
+            path = arg;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto ckpt = loadCheckpoint(path);
+    if (ckpt.agent == nullptr)
+        return 1;
+    const ActionValue<>& Q = ckpt.agent->values();
+
+    auto start = std::chrono::steady_clock::now();
+    Evaluation e = evaluateParallel(Q, config);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printEvaluation(std::cout, e);
+    std::cout << "Threads: " << (config.threads > 0 ? config.threads : defaultThreads())
+              << ", wall time (s): " << seconds << "\n";
+
+    if (check) {
+        EvaluationConfig serial = config;
+        serial.threads = 1;
+        start = std::chrono::steady_clock::now();
+        Evaluation s = evaluateParallel(Q, serial);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bool same = s.digest == e.digest and s.meanReturn == e.meanReturn and s.meanLength == e.meanLength
+                    and s.balanced == e.balanced;
+        std::cout << "One thread wall time (s): " << seconds << "\n"
+                  << "Identical on one thread: " << (same ? "yes" : "NO") << std::endl;
+        if (not same)
+            return 1;
+    }
+
+    bool pass = (not gateBalanced or e.balanced >= minBalanced) and (not gateReturn or e.meanReturn >= minReturn);
+    if (gateBalanced or gateReturn)
+        std::cout << "Gate: " << (pass ? "pass" : "fail") << std::endl;
+    return pass ? 0 : 2;
+}
@@ -0,0 +1,18 @@
+#include<string>
+#include<iostream>
+#include "State.hpp"
+#include "Checkpoint.hpp"
+
+// Writes the action values stored in a binary checkpoint out as CSV
+
+int main(int argc, char** argv) {
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " CHECKPOINT [CSV (default data.csv)]" << std::endl;
+        return 1;
+    }
+    auto ckpt = loadCheckpoint(argv[1]);
+    if (ckpt.agent == nullptr)
+        return 1;
+    ckpt.agent->dump(argc == 3 ? argv[2] : "data.csv");
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include<string>
+#include<iostream>
+#include<thread>
+#include "State.hpp"
+#include "Hogwild.hpp"
+
+// Scaling benchmark for Hogwild training.  For each thread count, trains a fresh table on the same
+// total episode budget and reports throughput and the quality of the resulting greedy policy.
+
+int main(int argc, char** argv) {
+    int maxThreads = std::thread::hardware_concurrency();
+    size_t episodes = 5000;
+    size_t maxSteps = 500;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" and i + 1 < argc)
+            maxThreads = std::stoi(argv[++i]);
+        else if (arg == "--episodes" and i + 1 < argc)
+            episodes = std::stoul(argv[++i]);
+        else if (arg == "--steps" and i + 1 < argc)
+            maxSteps = std::stoul(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--threads MAX] [--episodes N] [--steps N]" << std::endl;
+            return 1;
+        }
+    }
+    maxThreads = std::max(maxThreads, 1);
+
+    std::cout << "threads,actions,seconds,actions_per_s,speedup,eval_length,eval_return,eval_balanced" << std::endl;
+    double baseline = 0;
+    for (int threads = 1; threads <= maxThreads; threads = (threads == maxThreads) ? threads + 1 : std::min(2 * threads, maxThreads)) {
+        ActionValue<> Q;
+        auto stats = trainHogwild(Q, threads, episodes, maxSteps, 1, 0.75, EPSILON_C, 0);
+        double rate = stats.decisions / stats.seconds;
+        if (threads == 1)
+            baseline = rate;
+        auto quality = evaluatePolicy(Q, 1000, maxSteps, EVAL_SEED);
+        std::cout << threads << "," << stats.decisions << "," << stats.seconds << "," << rate << ","
+                  << rate / baseline << "," << quality.meanLength << "," << quality.meanReturn << ","
+                  << quality.balanced << std::endl;
+    }
+    return 0;
+}
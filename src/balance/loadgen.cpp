@@ -0,0 +1,117 @@
+#include<string>
+#include<chrono>
+#include<thread>
+#include<iostream>
+#include<algorithm>
+#include "State.hpp"
+#include "Serve.hpp"
+
+// Load generator for serve: each client thread keeps one request of random states in flight on
+// its own connection and times every round trip
+
+struct ClientResult {
+    std::vector<double> latencies;  // microseconds
+    size_t wrong = 0;               // answers whose action isn't the argmax of their values
+    bool failed = false;
+};
+
+void client(const std::string& path, uint32_t batch, double seconds, uint64_t seed, ClientResult& out) {
+    int fd = connectSocket(path);
+    if (fd < 0) {
+        out.failed = true;
+        return;
+    }
+    Rng rng(seed);
+    std::vector<uint8_t> request(sizeof(RequestHeader) + batch * sizeof(Query));
+    std::vector<Answer> answers(batch);
+    RequestHeader h{0, batch};
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+
+    while (std::chrono::steady_clock::now() < end) {
+        Query* q = reinterpret_cast<Query*>(request.data() + sizeof h);
+        for (uint32_t k = 0; k < batch; k++)
+            q[k] = Query{2 * M_PI * rng.uniform() - M_PI, 20 * rng.uniform() - 10};
+        h.id++;
+        std::memcpy(request.data(), &h, sizeof h);
+
+        auto start = std::chrono::steady_clock::now();
+        RequestHeader reply;
+        if (not sendAll(fd, request.data(), request.size()) or not recvAll(fd, &reply, sizeof reply)
+            or reply.id != h.id or reply.count != batch or not recvAll(fd, answers.data(), batch * sizeof(Answer))) {
+            out.failed = true;
+            break;
+        }
+        out.latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+
+        for (const Answer& a : answers) {
+            ActionValues<NUM_ACTIONS> v{};
+            for (int k = 0; k < NUM_ACTIONS; k++)
+                v.q[k] = a.q[k];
+            out.wrong += static_cast<int32_t>(ActionValue<>::argmax(v)) != a.action;
+        }
+    }
+    ::close(fd);
+}
+
+int main(int argc, char** argv) {
+    std::string path = DEFAULT_SOCKET;
+    int clients = 4;
+    uint32_t batch = 16;
+    double seconds = 5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--socket" and hasValue)
+            path = argv[++i];
+        else if (arg == "--clients" and hasValue)
+            clients = std::stoi(argv[++i]);
+        else if (arg == "--batch" and hasValue)
+            batch = std::stoul(argv[++i]);
+        else if (arg == "--seconds" and hasValue)
+            seconds = std::stod(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--socket PATH] [--clients N (default 4)] [--batch STATES (default 16)] [--seconds S (default 5)]" << std::endl;
+            return 1;
+        }
+    }
+    if (batch == 0 or batch > MAX_REQUEST_STATES) {
+        std::cerr << "--batch must be between 1 and " << MAX_REQUEST_STATES << std::endl;
+        return 1;
+    }
+
+    std::vector<ClientResult> results(clients);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; c++)
+        threads.emplace_back(client, path, batch, seconds, DEFAULT_SEED + c, std::ref(results[c]));
+    for (auto& t : threads)
+        t.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    size_t wrong = 0;
+    bool failed = false;
+    for (auto& r : results) {
+        all.insert(all.end(), r.latencies.begin(), r.latencies.end());
+        wrong += r.wrong;
+        failed |= r.failed;
+    }
+    if (all.empty()) {
+        std::cerr << "No requests completed" << std::endl;
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[std::min(all.size() - 1, size_t(p * all.size()))]; };
+
+    std::cout << "Clients: " << clients << "\n"
+              << "States per request: " << batch << "\n"
+              << "Requests: " << all.size() << "\n"
+              << "Requests/s: " << all.size() / elapsed << "\n"
+              << "States/s: " << all.size() * batch / elapsed << "\n"
+              << "Latency p50 (us): " << pct(0.5) << "\n"
+              << "Latency p99 (us): " << pct(0.99) << "\n"
+              << "Latency p999 (us): " << pct(0.999) << "\n"
+              << "Latency max (us): " << all.back() << "\n"
+              << "Inconsistent answers: " << wrong << std::endl;
+    return failed or wrong ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+#include<string>
+#include<cmath>
+#include<iostream>
+#include<vector>
+#include "State.hpp"
+#include "FastMath.hpp"
+
+// Checks the fast math kernels against std::sin, std::cos and fmod: the largest error of each
+// kernel over a dense grid, that the AVX versions agree with the scalar ones bit for bit, and how
+// far long rollouts of the fast physics drift from the reference physics.  Exits nonzero if any
+// of them is outside its bound.  Run it with make math-check.
+
+// Largest kernel errors allowed, in units in the last place of the correctly rounded result
+constexpr double SIN_MAX_ULP = 8;
+// Largest distance allowed between wrapAngle()/wrap2pi() and the exact remainder, for |x| <= 4 pi
+constexpr double WRAP_MAX_ERROR = 1e-15;
+// Largest angle or momentum difference allowed between the fast and reference physics after one
+// action interval from the same state, and after ROLLOUT_SECONDS of a free pendulum.  The fast
+// physics also has to stay within EXACT_TOLERANCE of the same integrator run in long double; the
+// reference physics doesn't, since its unwrapped theta loses precision as the pendulum spins.
+constexpr double INTERVAL_TOLERANCE = 1e-12;
+constexpr double ROLLOUT_TOLERANCE = 1e-6;
+constexpr double EXACT_TOLERANCE = 1e-8;
+constexpr double ROLLOUT_SECONDS = 1000;
+
+// update() as built without BALANCE_FAST_MATH ...
+void referenceStep(State& x) {
+    double F = (x.tl_on ? TORQUE_L : 0) + (x.tr_on ? TORQUE_R : 0) - MASS * GRAVITY_FORCE * std::sin(x.theta);
+    x.L += F * PHYSICS_TIMESTEP / MOMENT_OF_INERTIA;
+    x.theta += PHYSICS_TIMESTEP * x.L;
+}
+
+// ... and with it
+void fastStep(State& x) {
+    double F = (x.tl_on ? TORQUE_L : 0) + (x.tr_on ? TORQUE_R : 0) - MASS * GRAVITY_FORCE * fastSin(x.theta);
+    x.L += F * PHYSICS_TIMESTEP / MOMENT_OF_INERTIA;
+    x.theta = rewrap(x.theta + PHYSICS_TIMESTEP * x.L);
+}
+
+// The same physics in long double, as a yardstick for both
+struct ExactState {
+    long double theta;
+    long double L;
+};
+
+void exactStep(ExactState& x) {
+    long double F = -MASS * GRAVITY_FORCE * std::sin(x.theta);
+    x.L += F * PHYSICS_TIMESTEP / MOMENT_OF_INERTIA;
+    x.theta += PHYSICS_TIMESTEP * x.L;
+}
+
+double ulps(double x, long double exact) {
+    double rounded = double(exact);
+    double ulp = std::nextafter(std::fabs(rounded), INFINITY) - std::fabs(rounded);
+    return double(std::fabs(x - exact) / ulp);
+}
+
+// Exact remainders, in long double: the error of fmod() + pi is far below a double ulp
+long double exactAngle(double x) {
+    long double r = std::fmod((long double)x, 2 * M_PIl);
+    r += r >= M_PIl ? -2 * M_PIl : (r < -M_PIl ? 2 * M_PIl : 0);
+    return r;
+}
+
+long double exact2pi(double x) {
+    long double r = std::fmod((long double)x, 2 * M_PIl);
+    return r < 0 ? r + 2 * M_PIl : r;
+}
+
+// |a - b| as angles, with b wrapped and a not necessarily
+double angleDistance(double a, double b) {
+    double d = double(std::fabs(exactAngle(a) - (long double)b));
+    return std::min(d, 2 * M_PI - d);
+}
+
+int main(int argc, char** argv) {
+    size_t points = 4000000;
+    size_t intervals = 100000;
+    size_t rollouts = 64;
+    double seconds = ROLLOUT_SECONDS;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--points" and i + 1 < argc)
+            points = std::stoul(argv[++i]);
+        else if (arg == "--intervals" and i + 1 < argc)
+            intervals = std::stoul(argv[++i]);
+        else if (arg == "--rollouts" and i + 1 < argc)
+            rollouts = std::stoul(argv[++i]);
+        else if (arg == "--seconds" and i + 1 < argc)
+            seconds = std::stod(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--points N] [--intervals N] [--rollouts N] [--seconds S]" << std::endl;
+            return 1;
+        }
+    }
+    bool ok = true;
+
+    // Kernels over [-4 pi, 4 pi], offset so the grid doesn't land on multiples of pi
+    double sinUlp = 0, cosUlp = 0, wrapErr = 0, wrap2piErr = 0, fmodErr = 0;
+    size_t simdMismatches = 0;
+    std::vector<double> xs(points);
+    for (size_t k = 0; k < points; k++)
+        xs[k] = (double(k) / points * 8 - 4) * M_PI + 1e-7;
+    for (double x : xs) {
+        sinUlp = std::max(sinUlp, ulps(fastSin(x), std::sin((long double)x)));
+        cosUlp = std::max(cosUlp, ulps(fastCos(x), std::cos((long double)x)));
+        wrapErr = std::max(wrapErr, double(std::fabs(wrapAngle(x) - exactAngle(x))));
+        wrap2piErr = std::max(wrap2piErr, double(std::fabs(wrap2pi(x) - exact2pi(x))));
+        // The reference angle(), for comparison
+        double r = std::fmod(x + M_PI, 2 * M_PI);
+        r = (r < 0 ? r + 2 * M_PI : r) - M_PI;
+        fmodErr = std::max(fmodErr, double(std::fabs(r - exactAngle(x))));
+    }
+#ifdef __AVX__
+    for (size_t k = 0; k + 4 <= points; k += 4) {
+        __m256d x = _mm256_loadu_pd(&xs[k]);
+        alignas(32) double out[5][4];
+        _mm256_store_pd(out[0], fastSin(x));
+        _mm256_store_pd(out[1], fastCos(x));
+        _mm256_store_pd(out[2], wrapAngle(x));
+        _mm256_store_pd(out[3], wrap2pi(x));
+        _mm256_store_pd(out[4], rewrap(x));
+        for (int j = 0; j < 4; j++) {
+            double x1 = xs[k + j];
+            simdMismatches += out[0][j] != fastSin(x1) or out[1][j] != fastCos(x1) or out[2][j] != wrapAngle(x1)
+                              or out[3][j] != wrap2pi(x1) or out[4][j] != rewrap(x1);
+        }
+    }
+#endif
+    ok = ok and sinUlp <= SIN_MAX_ULP and cosUlp <= SIN_MAX_ULP and wrapErr <= WRAP_MAX_ERROR
+            and wrap2piErr <= WRAP_MAX_ERROR and simdMismatches == 0;
+    std::cout << "fastSin max error: " << sinUlp << " ulp (bound " << SIN_MAX_ULP << ")\n"
+              << "fastCos max error: " << cosUlp << " ulp (bound " << SIN_MAX_ULP << ")\n"
+              << "wrapAngle max error: " << wrapErr << " (bound " << WRAP_MAX_ERROR << ", fmod angle() " << fmodErr << ")\n"
+              << "wrap2pi max error: " << wrap2piErr << " (bound " << WRAP_MAX_ERROR << ")\n"
+#ifdef __AVX__
+              << "AVX lanes differing from scalar: " << simdMismatches << "\n"
+#endif
+              ;
+
+    // One action interval from identical states, with random torques, like batch's check
+    // Also checks that this build's update() is the step it claims to be
+    seedThread(0);
+    double stepTheta = 0, stepL = 0;
+    size_t updateMismatches = 0;
+    for (size_t k = 0; k < intervals; k++) {
+        State ref{2 * M_PI * uniform() - M_PI, MIN_VELOCITY + (MAX_VELOCITY - MIN_VELOCITY) * uniform(), false, false, false};
+        act(ref, static_cast<Action>(uniformInt(0, NUM_ACTIONS)));
+        State fast = ref;
+        State built = ref;
+        for (int s = 0; s < PHYSICS_STEPS_PER_ACTION; s++) {
+            referenceStep(ref);
+            fastStep(fast);
+            update(built);
+        }
+#ifdef BALANCE_FAST_MATH
+        updateMismatches += built.theta != fast.theta or built.L != fast.L;
+#else
+        updateMismatches += built.theta != ref.theta or built.L != ref.L;
+#endif
+        stepTheta = std::max(stepTheta, angleDistance(ref.theta, fast.theta));
+        stepL = std::max(stepL, std::fabs(ref.L - fast.L));
+    }
+    ok = ok and stepTheta <= INTERVAL_TOLERANCE and stepL <= INTERVAL_TOLERANCE and updateMismatches == 0;
+    std::cout << "Action intervals: " << intervals << "\n"
+#ifdef BALANCE_FAST_MATH
+              << "update() (fast math build) differing from the fast step: " << updateMismatches << "\n"
+#else
+              << "update() (reference build) differing from the reference step: " << updateMismatches << "\n"
+#endif
+              << "Max drift per interval: theta " << stepTheta << ", L " << stepL << " (tolerance " << INTERVAL_TOLERANCE << ")\n";
+
+    // Long rollouts of the free pendulum, swinging and spinning.  With torques switching at random
+    // the motion is chaotic and any difference of an ulp grows until the trajectories are
+    // unrelated, so only the free pendulum measures how rounding accumulates.
+    size_t steps = size_t(seconds / PHYSICS_TIMESTEP);
+    double maxTheta = 0, maxL = 0, maxUnwrapped = 0, refExact = 0, fastExact = 0;
+    for (size_t r = 0; r < rollouts; r++) {
+        State ref{2 * M_PI * uniform() - M_PI, MIN_VELOCITY + (MAX_VELOCITY - MIN_VELOCITY) * uniform(), false, false, false};
+        State fast = ref;
+        ExactState exact{ref.theta, ref.L};
+        for (size_t s = 0; s < steps; s++) {
+            referenceStep(ref);
+            fastStep(fast);
+            exactStep(exact);
+        }
+        maxUnwrapped = std::max(maxUnwrapped, std::fabs(ref.theta));
+        maxTheta = std::max(maxTheta, angleDistance(ref.theta, fast.theta));
+        maxL = std::max(maxL, std::fabs(ref.L - fast.L));
+        refExact = std::max(refExact, double(std::fabs(exact.theta - ref.theta)));
+        fastExact = std::max(fastExact, double(std::fabs(exactAngle(double(exact.theta)) - fast.theta)));
+    }
+    ok = ok and maxTheta <= ROLLOUT_TOLERANCE and maxL <= ROLLOUT_TOLERANCE and fastExact <= EXACT_TOLERANCE;
+    std::cout << "Rollouts: " << rollouts << " of " << seconds << " s (" << steps << " physics steps)\n"
+              << "Largest reference theta: " << maxUnwrapped << "\n"
+              << "Max rollout drift: theta " << maxTheta << ", L " << maxL << " (tolerance " << ROLLOUT_TOLERANCE << ")\n"
+              << "Max theta drift from long double physics: reference " << refExact << ", fast " << fastExact
+              << " (tolerance " << EXACT_TOLERANCE << ")" << std::endl;
+    return ok ? 0 : 1;
+}
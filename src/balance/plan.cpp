@@ -0,0 +1,56 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Planner.hpp"
+#include "Checkpoint.hpp"
+
+// Plans a policy by value iteration over the tile grid instead of learning it from samples
+
+int main(int argc, char** argv) {
+    float gamma = 0.75;
+    int threads = 0;
+    double tolerance = 1e-6;
+    std::string savePath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--gamma" and hasValue)
+            gamma = std::stof(argv[++i]);
+        else if (arg == "--threads" and hasValue)
+            threads = std::stoi(argv[++i]);
+        else if (arg == "--tolerance" and hasValue)
+            tolerance = std::stod(argv[++i]);
+        else if (arg == "--save" and hasValue)
+            savePath = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--gamma X] [--threads N (default all cores)] [--tolerance X] [--save PATH]" << std::endl;
+            return 1;
+        }
+    }
+
+    Planner planner(gamma, threads);
+    auto t0 = std::chrono::steady_clock::now();
+    planner.buildModel();
+    auto t1 = std::chrono::steady_clock::now();
+    int sweeps = planner.solve(tolerance);
+    auto t2 = std::chrono::steady_clock::now();
+
+    Agent Bond(1, gamma, planner.actionValue());
+    auto quality = evaluatePolicy(Bond, 1000, 1000, EVAL_SEED);
+
+    std::cout << "Cells: " << planner.size() << "\n"
+              << "Model build (s): " << std::chrono::duration<double>(t1 - t0).count() << "\n"
+              << "Value iteration sweeps: " << sweeps << "\n"
+              << "Value iteration (s): " << std::chrono::duration<double>(t2 - t1).count() << "\n"
+              << "Greedy mean length: " << quality.meanLength << "\n"
+              << "Greedy mean return: " << quality.meanReturn << "\n"
+              << "Greedy balanced fraction (upright " << BALANCE_SECONDS << " s): " << quality.balanced << "\n"
+              << "Greedy upright fraction: " << quality.upright << "\n"
+              << "Greedy unbroken fraction: " << quality.unbroken << std::endl;
+
+    if (not savePath.empty() and not saveCheckpoint(savePath, Bond, EPSILON_C))
+        return 1;
+    return 0;
+}
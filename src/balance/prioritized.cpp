@@ -0,0 +1,92 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include<memory>
+#include<vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Evaluate.hpp"
+#include "PrioritizedSweeping.hpp"
+
+// Sample efficiency of prioritized sweeping.  One-step SARSA on the one-tiling table, on the default
+// tiling, and SARSA plus each planning budget train on the same episodes in step.  Each learner is
+// evaluated greedily after every doubling of the episode count.  Prints CSV.
+
+struct Learner {
+    std::string name;
+    std::unique_ptr<Agent> agent;
+    std::unique_ptr<PrioritizedSweeping> sweeper;
+    int budget;
+    size_t step = 0;
+    double seconds = 0;
+
+    // Sweeps budget backups per action, or none for plain SARSA
+    Learner(const std::string& name, std::unique_ptr<Agent> agent, int budget = 0):
+        name(name), agent(std::move(agent)), budget(budget) {
+        if (budget > 0)
+            sweeper = std::make_unique<PrioritizedSweeping>(this->agent->values(), this->agent->discount());
+    }
+};
+
+int main(int argc, char** argv) {
+    size_t episodes = 2000;
+    size_t maxSteps = 1000;
+    size_t evalEpisodes = 1000;
+    std::vector<int> budgets = {5, 20, 100};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--episodes" and hasValue)
+            episodes = std::stoul(argv[++i]);
+        else if (arg == "--max-steps" and hasValue)
+            maxSteps = std::stoul(argv[++i]);
+        else if (arg == "--eval-episodes" and hasValue)
+            evalEpisodes = std::stoul(argv[++i]);
+        else if (arg == "--budget" and hasValue)
+            budgets = {std::stoi(argv[++i])};
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--episodes N] [--max-steps N] [--eval-episodes M] [--budget BACKUPS]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Learner> learners;
+    learners.emplace_back("sarsa_1_tiling", std::make_unique<Agent>(1, 0.75, 1));
+    learners.emplace_back("sarsa_" + std::to_string(NUM_TILINGS) + "_tilings", std::make_unique<Agent>(1, 0.75));
+    for (int b : budgets)
+        learners.emplace_back("sweep_" + std::to_string(b), std::make_unique<Agent>(1, 0.75, 1), b);
+
+    EvaluationConfig config;
+    config.episodes = evalEpisodes;
+    config.maxSteps = maxSteps;
+    std::cout << "method,episodes,actions,backups,train_seconds,eval_length,eval_return,eval_balanced,eval_upright,eval_unbroken" << std::endl;
+    size_t done = 0;
+    std::vector<State> starts;
+    for (size_t stop = std::min<size_t>(25, episodes); done < episodes; stop = std::min(2 * stop, episodes)) {
+        // Every learner trains from the same start states.  Exploration draws from the same
+        // generator, so the starts are drawn once up front instead of between episodes.
+        seedThread(done + 1);
+        starts.clear();
+        for (size_t ep = done; ep < stop; ep++)
+            starts.push_back(randomState());
+        for (Learner& l : learners) {
+            auto observe = [&](const State& prev, Action a, double reward, const State& next) {
+                if (l.sweeper) {
+                    l.sweeper->observe(prev, a, reward, next);
+                    l.sweeper->plan(l.budget);
+                }
+            };
+            seedThread(stop);
+            auto start = std::chrono::steady_clock::now();
+            for (const State& x0 : starts)
+                runEpisode(*l.agent, x0, maxSteps, l.step, EPSILON_C, observe);
+            l.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            Evaluation e = evaluateParallel(l.agent->values(), config);
+            std::cout << l.name << "," << stop << "," << l.step << "," << (l.sweeper ? l.sweeper->backupCount() : 0) << ","
+                      << l.seconds << "," << e.meanLength << "," << e.meanReturn << "," << e.balanced << "," << e.upright << "," << e.unbroken << std::endl;
+        }
+        done = stop;
+    }
+    return 0;
+}
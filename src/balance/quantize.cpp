@@ -0,0 +1,202 @@
+#include<string>
+#include<chrono>
+#include<cmath>
+#include<iostream>
+#include<vector>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Quantized.hpp"
+#include "Checkpoint.hpp"
+
+// Compares the float action-value table with fp16 and int8 storage: bytes, lookup throughput on
+// this build's table and on a finer grid that doesn't fit in cache, and greedy policy quality, both
+// for a trained float table rounded to each format and for tables trained in that format from
+// scratch.  Training in a format is run with stochastic and with nearest rounding, to show what the
+// stochastic rounding buys.
+
+// Finer grid for the lookup benchmark: 8 tilings of 401 x 401 cells is 20 MB of floats
+constexpr int LARGE_BINS = 400;
+
+constexpr size_t LOOKUP_STATES = 1 << 16;
+constexpr size_t LOOKUPS = 1 << 24;
+constexpr size_t EVAL_EPISODES = 1000;
+
+volatile float sink;
+
+std::vector<State> lookupStates(void) {
+    seedThread(7);
+    std::vector<State> states(LOOKUP_STATES);
+    for (State& x : states)
+        x = State{2 * M_PI * uniform() - M_PI, MIN_VELOCITY + (MAX_VELOCITY - MIN_VELOCITY) * uniform(), false, false, false};
+    return states;
+}
+
+// ns per values() call over random states
+template<typename Table>
+double lookupNs(const Table& Q, const std::vector<State>& states) {
+    float total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < LOOKUPS; i++)
+        total += Q.values(states[i % LOOKUP_STATES]).q[0];
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sink = total;
+    return seconds * 1e9 / LOOKUPS;
+}
+
+template<typename A>
+double train(A& agent, size_t episodes, size_t maxSteps, double epsC) {
+    seedThread(1);
+    size_t step = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t ep = 0; ep < episodes; ep++)
+        runEpisode(agent, randomState(), maxSteps, step, epsC);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Largest and mean absolute difference between two tables' weights
+void weightError(const float* a, const float* b, size_t n, double& largest, double& mean) {
+    largest = mean = 0;
+    for (size_t i = 0; i < n; i++) {
+        double d = std::fabs(double(a[i]) - b[i]);
+        largest = std::max(largest, d);
+        mean += d;
+    }
+    mean /= n;
+}
+
+void reportQuality(const std::string& name, const PolicyQuality& q) {
+    std::cout << name << " greedy mean length: " << q.meanLength << ", mean return: " << q.meanReturn
+              << ", balanced fraction: " << q.balanced << ", upright fraction: " << q.upright
+              << ", unbroken fraction: " << q.unbroken << "\n";
+}
+
+template<WeightFormat Format>
+void compareRounded(Agent& reference, const std::vector<State>& states, size_t maxSteps) {
+    const ActionValue<>& F = reference.values();
+    auto table = std::make_unique<QuantizedValue<Format>>(F);
+    std::vector<float> widened(F.size());
+    table->toFloat(widened.data());
+    double largest, mean;
+    weightError(F.data(), widened.data(), F.size(), largest, mean);
+
+    std::string name = formatName(Format);
+    std::cout << name << " bytes: " << table->bytes() << "\n"
+              << name << " lookup (ns): " << lookupNs(*table, states) << "\n"
+              << name << " rounding error: max " << largest << ", mean " << mean << "\n";
+    QuantizedAgent<Format> agent(reference.stepSize(), reference.discount(), std::move(table));
+    reportQuality(name + " rounded", evaluatePolicy(agent, EVAL_EPISODES, maxSteps, EVAL_SEED));
+}
+
+// Trained on the same episode seeds as reference, which it drifts away from as soon as a rounded
+// value changes a greedy choice; the weight distance is a rough measure of how much was lost
+template<WeightFormat Format>
+void compareTrained(Agent& reference, size_t episodes, size_t maxSteps, double epsC, bool stochastic) {
+    QuantizedAgent<Format> agent(reference.stepSize(), reference.discount(), NUM_TILINGS, 0, stochastic);
+    double seconds = train(agent, episodes, maxSteps, epsC);
+    const ActionValue<>& F = reference.values();
+    std::vector<float> widened(F.size());
+    agent.values().toFloat(widened.data());
+    double largest, mean;
+    weightError(F.data(), widened.data(), F.size(), largest, mean);
+    std::string name = std::string(formatName(Format)) + (stochastic ? " stochastic" : " nearest");
+    std::cout << name << " training (s): " << seconds << "\n"
+              << name << " distance from f32 trained: max " << largest << ", mean " << mean << "\n";
+    reportQuality(name + " trained", evaluatePolicy(agent, EVAL_EPISODES, maxSteps, EVAL_SEED));
+}
+
+// Lookups on a table too big for the cache, weights filled with plausible values
+void compareLarge(const std::vector<State>& states) {
+    ActionValue<LARGE_BINS, LARGE_BINS> F;
+    seedThread(3);
+    for (size_t i = 0; i < F.size(); i++)
+        F.data()[i] = -50 * float(uniform());
+    QuantizedValue<WeightFormat::f16, LARGE_BINS, LARGE_BINS> half(F);
+    QuantizedValue<WeightFormat::i8, LARGE_BINS, LARGE_BINS> byte(F);
+    std::cout << LARGE_BINS << "x" << LARGE_BINS << " grid bytes: f32 " << F.size() * sizeof(float)
+              << ", fp16 " << half.bytes() << ", int8 " << byte.bytes() << "\n"
+              << LARGE_BINS << "x" << LARGE_BINS << " grid lookup (ns): f32 " << lookupNs(F, states)
+              << ", fp16 " << lookupNs(half, states) << ", int8 " << lookupNs(byte, states) << "\n";
+}
+
+int main(int argc, char** argv) {
+    size_t episodes = 2000;
+    size_t maxSteps = 1000;
+    float alpha = 1;
+    float gamma = 0.75;
+    double epsC = EPSILON_C;
+    std::string loadPath, savePath;
+    WeightFormat saveFormat = WeightFormat::i8;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--episodes" and hasValue)
+            episodes = std::stoul(argv[++i]);
+        else if (arg == "--max-steps" and hasValue)
+            maxSteps = std::stoul(argv[++i]);
+        else if (arg == "--alpha" and hasValue)
+            alpha = std::stof(argv[++i]);
+        else if (arg == "--load" and hasValue)
+            loadPath = argv[++i];
+        else if (arg == "--save" and hasValue)
+            savePath = argv[++i];
+        else if (arg == "--format" and hasValue) {
+            std::string f = argv[++i];
+            if (f == "fp16")
+                saveFormat = WeightFormat::f16;
+            else if (f == "int8")
+                saveFormat = WeightFormat::i8;
+            else {
+                std::cerr << "Unknown format " << f << std::endl;
+                return 1;
+            }
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--episodes N] [--max-steps N] [--alpha X] [--load CKPT]\n"
+                      << "       [--save CKPT --format fp16|int8]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::unique_ptr<Agent> reference;
+    if (loadPath.empty()) {
+        reference = std::make_unique<Agent>(alpha, gamma);
+        std::cout << "f32 training (s): " << train(*reference, episodes, maxSteps, epsC) << "\n";
+    }
+    else {
+        auto ckpt = loadCheckpoint(loadPath);
+        if (ckpt.agent == nullptr)
+            return 1;
+        reference = std::move(ckpt.agent);
+        epsC = ckpt.epsC;
+    }
+
+    std::vector<State> states = lookupStates();
+    const ActionValue<>& F = reference->values();
+    std::cout << "f32 bytes: " << F.size() * sizeof(float) << "\n"
+              << "f32 lookup (ns): " << lookupNs(F, states) << "\n";
+    reportQuality("f32", evaluatePolicy(*reference, EVAL_EPISODES, maxSteps, EVAL_SEED));
+    compareRounded<WeightFormat::f16>(*reference, states, maxSteps);
+    compareRounded<WeightFormat::i8>(*reference, states, maxSteps);
+    compareLarge(states);
+
+    if (loadPath.empty()) {
+        for (bool stochastic : {true, false}) {
+            compareTrained<WeightFormat::f16>(*reference, episodes, maxSteps, epsC, stochastic);
+            compareTrained<WeightFormat::i8>(*reference, episodes, maxSteps, epsC, stochastic);
+        }
+    }
+
+    // Round trip through a quantized checkpoint
+    if (not savePath.empty()) {
+        if (not saveCheckpoint(savePath, *reference, epsC, 0, saveFormat))
+            return 1;
+        auto ckpt = loadCheckpoint(savePath);
+        if (ckpt.agent == nullptr)
+            return 1;
+        double largest, mean;
+        weightError(F.data(), ckpt.agent->values().data(), F.size(), largest, mean);
+        std::cout << "Saved " << formatName(saveFormat) << " checkpoint " << savePath
+                  << ", reloaded weight error: max " << largest << ", mean " << mean << std::endl;
+    }
+    return 0;
+}
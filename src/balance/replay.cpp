@@ -0,0 +1,181 @@
+#include<string>
+#include<chrono>
+#include<cstdio>
+#include<iostream>
+#include "State.hpp"
+#include "Trajectory.hpp"
+#ifdef WITH_GL
+#include "Render.hpp"
+#include "Scheduler.hpp"
+#endif
+
+// Lists, dumps, verifies or plays back episodes recorded with train --record.  Playback needs the
+// OpenGL build (make src/balance/replay-gl); the other modes work anywhere.
+
+struct Episode {
+    size_t begin;   // index of the start record
+    size_t end;
+    double ret = 0;
+    bool broken = false;
+};
+
+std::vector<Episode> splitEpisodes(const std::vector<TrajectoryRecord>& records) {
+    std::vector<Episode> out;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].start or out.empty())
+            out.push_back(Episode{i, i});
+        Episode& e = out.back();
+        e.end = i + 1;
+        e.ret += records[i].reward;
+        e.broken |= records[i].broken;
+    }
+    return out;
+}
+
+// Re-integrates the physics between the records of one episode and yields every substep to
+// visit(prev, cur).  Returns how many records the integration doesn't reproduce bit for bit,
+// which is nonzero only for episodes trained with the interpolated transition cache.
+template<typename F>
+size_t integrate(const std::vector<TrajectoryRecord>& records, const Episode& e, F&& visit) {
+    State x{records[e.begin].theta, records[e.begin].L, false, false, false};
+    size_t mismatches = 0;
+    for (size_t i = e.begin + 1; i < e.end; i++) {
+        act(x, records[i].action);
+        for (int k = 0; k < PHYSICS_STEPS_PER_ACTION; k++) {
+            State prev = x;
+            update(x);
+            visit(prev, x);
+        }
+        if (x.theta != records[i].theta or x.L != records[i].L)
+            mismatches++;
+        // Carry on from the recorded state so one mismatch doesn't spoil the rest
+        x.theta = records[i].theta;
+        x.L = records[i].L;
+    }
+    return mismatches;
+}
+
+#ifdef WITH_GL
+// Plays an episode in real time, scaled by speed, until it ends or the window is closed
+void play(const std::vector<TrajectoryRecord>& records, const Episode& e, double speed) {
+    GLFWwindow* window = initOpenGL(1000, 1000);
+    if (window == nullptr)
+        return;
+    Scene scene = initScene();
+
+    // Physics substeps shown per frame
+    double perFrame = SECONDS_BETWEEN_FRAMES * speed / PHYSICS_TIMESTEP;
+    double due = 0;
+    FixedTimestep frames(SECONDS_BETWEEN_FRAMES);
+    integrate(records, e, [&](const State& prev, const State& cur) {
+        if (glfwWindowShouldClose(window))
+            return;
+        due -= 1;
+        if (due > 0)
+            return;
+        due += perFrame;
+        render(cur, prev, 1, scene, window);
+        glfwPollEvents();
+        State ignored = cur;
+        processInput(window, ignored, false);
+        frames.wait();
+    });
+    glfwTerminate();
+}
+#endif
+
+void usage(const char* name) {
+    std::cerr << "Usage: " << name << " TRAJECTORY [options]\n"
+              << "  (no options)   list the recorded episodes\n"
+              << "  --episode N    pick episode N for the options below (default all for --text and --verify)\n"
+              << "  --text         dump records as CSV: step,theta,L,action,reward,broken\n"
+              << "  --verify       re-integrate the physics and count records it doesn't reproduce\n"
+              << "  --play         animate the episode (OpenGL build only)\n"
+              << "  --speed X      playback speed for --play (OpenGL build only, default 1)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string path = argv[1];
+    long episode = -1;
+    bool text = false, verify = false, playBack = false;
+#ifdef WITH_GL
+    double speed = 1;
+#endif
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--episode" and hasValue)
+            episode = std::stol(argv[++i]);
+        else if (arg == "--text")
+            text = true;
+        else if (arg == "--verify")
+            verify = true;
+        else if (arg == "--play")
+            playBack = true;
+#ifdef WITH_GL
+        else if (arg == "--speed" and hasValue)
+            speed = std::stod(argv[++i]);
+#endif
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<TrajectoryRecord> records;
+    if (not readTrajectory(path, records))
+        return 1;
+    auto episodes = splitEpisodes(records);
+    if (episode >= long(episodes.size())) {
+        std::cerr << "Only " << episodes.size() << " episodes recorded" << std::endl;
+        return 1;
+    }
+    size_t first = episode < 0 ? 0 : episode;
+    size_t last = episode < 0 ? episodes.size() : episode + 1;
+
+    if (playBack) {
+#ifdef WITH_GL
+        if (episode < 0) {
+            std::cerr << "--play needs --episode" << std::endl;
+            return 1;
+        }
+        play(records, episodes[episode], speed);
+        return 0;
+#else
+        std::cerr << "Built without OpenGL; use " << argv[0] << "-gl to play episodes" << std::endl;
+        return 1;
+#endif
+    }
+
+    if (text) {
+        std::printf("step,theta,L,action,reward,broken\n");
+        for (size_t e = first; e < last; e++)
+            for (size_t i = episodes[e].begin; i < episodes[e].end; i++) {
+                const TrajectoryRecord& r = records[i];
+                std::printf("%llu,%.17g,%.17g,%d,%.17g,%d\n", (unsigned long long)r.step, r.theta, r.L,
+                            static_cast<int>(r.action), r.reward, int(r.broken));
+            }
+        return 0;
+    }
+
+    if (verify) {
+        size_t checked = 0, mismatches = 0;
+        for (size_t e = first; e < last; e++) {
+            mismatches += integrate(records, episodes[e], [](const State&, const State&) {});
+            checked += episodes[e].end - episodes[e].begin - 1;
+        }
+        std::cout << "Records checked: " << checked << "\n"
+                  << "Not reproduced: " << mismatches << std::endl;
+        return mismatches != 0;
+    }
+
+    std::cout << "episode,start_step,actions,return,broken\n";
+    for (size_t e = first; e < last; e++)
+        std::cout << e << ',' << records[episodes[e].begin].step << ',' << episodes[e].end - episodes[e].begin - 1 << ','
+                  << episodes[e].ret << ',' << episodes[e].broken << '\n';
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include<string>
+#include<csignal>
+#include<iostream>
+#include "State.hpp"
+#include "Checkpoint.hpp"
+#include "Serve.hpp"
+
+// Serves a checkpoint's greedy actions and action values over a Unix domain socket until
+// interrupted.  See Serve.hpp for the protocol and loadgen.cpp for a client.
+
+void stopServing(int) {
+    serveStop = 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 or argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " CHECKPOINT [SOCKET (default " << DEFAULT_SOCKET << ")]" << std::endl;
+        return 1;
+    }
+    std::string path = argc == 3 ? argv[2] : DEFAULT_SOCKET;
+    auto ckpt = loadCheckpoint(argv[1]);
+    if (ckpt.agent == nullptr)
+        return 1;
+
+    PolicyServer server(ckpt.agent->values());
+    if (not server.listen(path))
+        return 1;
+    std::signal(SIGINT, stopServing);
+    std::signal(SIGTERM, stopServing);
+    std::cerr << "Serving " << argv[1] << " on " << path << std::endl;
+    server.run();
+    ::unlink(path.c_str());
+
+    const ServeStats& s = server.statistics();
+    std::cout << "Connections: " << s.connections << "\n"
+              << "Requests: " << s.requests << "\n"
+              << "States: " << s.states << "\n"
+              << "Batches: " << s.batches << "\n"
+              << "Mean requests per batch: " << (s.batches ? double(s.requests) / s.batches : 0) << "\n"
+              << "Largest batch (states): " << s.largestBatch << std::endl;
+    return 0;
+}
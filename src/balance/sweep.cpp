@@ -0,0 +1,223 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include<algorithm>
+#include "State.hpp"
+#include "Sweep.hpp"
+
+// Trains one agent per hyperparameter setting, in parallel, and writes every learning curve and
+// final score to one CSV.  Each parameter takes a list of values ("0.1,0.5,1"); the grid is the
+// cartesian product of the lists.  With --random N, N settings are drawn instead and a parameter
+// can also be a range ("0.05:1") sampled uniformly.
+
+struct ParamSpec {
+    std::vector<double> values;
+    bool range = false;     // values holds {lo, hi}
+
+    ParamSpec(double x): values{x} {}
+
+    static bool parse(const std::string& text, ParamSpec& out) {
+        out.values.clear();
+        size_t colon = text.find(':');
+        out.range = colon != std::string::npos;
+        try {
+            if (out.range) {
+                out.values = {std::stod(text.substr(0, colon)), std::stod(text.substr(colon + 1))};
+                return out.values[0] <= out.values[1];
+            }
+            size_t pos = 0;
+            while (pos <= text.size()) {
+                size_t comma = std::min(text.find(',', pos), text.size());
+                out.values.push_back(std::stod(text.substr(pos, comma - pos)));
+                pos = comma + 1;
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        return not out.values.empty();
+    }
+
+    double sample(Rng& rng, bool integer) const {
+        if (not range)
+            return values[rng.uniformInt(0, values.size())];
+        if (integer)
+            return double(rng.uniformInt(int(values[0]), int(values[1]) + 1));
+        return values[0] + (values[1] - values[0]) * rng.uniform();
+    }
+};
+
+void usage(const char* name) {
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  --alpha SPEC            step size (default 1)\n"
+              << "  --gamma SPEC            discount (default 0.75)\n"
+              << "  --eps-c SPEC            exploration constant (default EPSILON_C)\n"
+              << "  --angle-buckets LIST    one or more of 25,50,100,200 (default 100)\n"
+              << "  --velocity-buckets LIST one or more of 25,50,100,200 (default 100)\n"
+              << "  --torque SPEC           motor torque magnitude (default 3)\n"
+              << "  --tilings SPEC          number of tilings (default 8)\n"
+              << "  --random N              sample N settings instead of running the full grid\n"
+              << "  --seeds N               training seeds per setting (default 1)\n"
+              << "  --seed N                base seed for training and sampling\n"
+              << "  --episodes N            training episodes per job (default 2000)\n"
+              << "  --steps N               action cap per episode (default 1000)\n"
+              << "  --window N              episodes per learning-curve point (default 100)\n"
+              << "  --eval-episodes N       greedy evaluation episodes per job (default 100)\n"
+              << "  --threads N             worker threads (default all cores)\n"
+              << "  --out PATH              results file (default sweep.csv)\n"
+              << "SPEC is a comma-separated list, or lo:hi with --random" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    SweepConfig base;
+    ParamSpec alpha(base.alpha), gamma(base.gamma), epsC(base.epsC), angleBuckets(base.angleBuckets),
+              velocityBuckets(base.velocityBuckets), torque(base.torque), tilings(base.tilings);
+    SweepSchedule schedule;
+    size_t samples = 0;
+    size_t seeds = 1;
+    uint64_t seed = DEFAULT_SEED;
+    int threads = 0;
+    std::string outPath = "sweep.csv";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        ParamSpec* spec = nullptr;
+        if (arg == "--alpha")
+            spec = &alpha;
+        else if (arg == "--gamma")
+            spec = &gamma;
+        else if (arg == "--eps-c")
+            spec = &epsC;
+        else if (arg == "--angle-buckets")
+            spec = &angleBuckets;
+        else if (arg == "--velocity-buckets")
+            spec = &velocityBuckets;
+        else if (arg == "--torque")
+            spec = &torque;
+        else if (arg == "--tilings")
+            spec = &tilings;
+
+        if (spec and hasValue) {
+            if (not ParamSpec::parse(argv[++i], *spec)) {
+                std::cerr << "Bad value for " << arg << ": " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--random" and hasValue)
+            samples = std::stoul(argv[++i]);
+        else if (arg == "--seeds" and hasValue)
+            seeds = std::stoul(argv[++i]);
+        else if (arg == "--seed" and hasValue)
+            seed = std::stoull(argv[++i]);
+        else if (arg == "--episodes" and hasValue)
+            schedule.episodes = std::stoul(argv[++i]);
+        else if (arg == "--steps" and hasValue)
+            schedule.maxSteps = std::stoul(argv[++i]);
+        else if (arg == "--window" and hasValue)
+            schedule.window = std::stoul(argv[++i]);
+        else if (arg == "--eval-episodes" and hasValue)
+            schedule.evalEpisodes = std::stoul(argv[++i]);
+        else if (arg == "--threads" and hasValue)
+            threads = std::stoi(argv[++i]);
+        else if (arg == "--out" and hasValue)
+            outPath = argv[++i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    for (ParamSpec* spec : {&angleBuckets, &velocityBuckets}) {
+        for (double b : spec->values)
+            if (spec->range or not supportedBuckets(int(b))) {
+                std::cerr << "Bucket counts must be listed from 25, 50, 100 and 200" << std::endl;
+                return 1;
+            }
+    }
+    if (samples == 0) {
+        for (ParamSpec* spec : {&alpha, &gamma, &epsC, &torque, &tilings})
+            if (spec->range) {
+                std::cerr << "Ranges need --random" << std::endl;
+                return 1;
+            }
+    }
+    if (schedule.window == 0 or seeds == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Settings, then one job per setting and seed.  Replicate r uses seed + r in every setting so
+    // settings are compared on the same random streams.
+    std::vector<SweepConfig> settings;
+    if (samples) {
+        Rng rng(seed);
+        for (size_t k = 0; k < samples; k++) {
+            SweepConfig c;
+            c.alpha = alpha.sample(rng, false);
+            c.gamma = gamma.sample(rng, false);
+            c.epsC = epsC.sample(rng, false);
+            c.angleBuckets = int(angleBuckets.sample(rng, true));
+            c.velocityBuckets = int(velocityBuckets.sample(rng, true));
+            c.torque = torque.sample(rng, false);
+            c.tilings = int(tilings.sample(rng, true));
+            settings.push_back(c);
+        }
+    }
+    else {
+        for (double a : alpha.values)
+        for (double g : gamma.values)
+        for (double e : epsC.values)
+        for (double ab : angleBuckets.values)
+        for (double vb : velocityBuckets.values)
+        for (double t : torque.values)
+        for (double n : tilings.values)
+            settings.push_back(SweepConfig{a, g, e, int(ab), int(vb), t, int(n), 0});
+    }
+    for (SweepConfig& c : settings)
+        c.tilings = std::max(1, std::min(c.tilings, MAX_TILINGS));
+
+    std::vector<SweepConfig> jobs;
+    for (const SweepConfig& c : settings)
+        for (size_t r = 0; r < seeds; r++) {
+            jobs.push_back(c);
+            jobs.back().seed = seed + r;
+        }
+
+    if (threads <= 0)
+        threads = defaultThreads();
+    auto start = std::chrono::steady_clock::now();
+    auto results = runSweep(jobs, schedule, threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (not writeSweepResults(outPath, results))
+        return 1;
+
+    // Final scores averaged over seeds, best setting first
+    struct Summary {
+        size_t setting;
+        double ret = 0;
+        double balanced = 0;
+    };
+    std::vector<Summary> summary;
+    for (size_t s = 0; s < settings.size(); s++) {
+        Summary row{s};
+        for (size_t r = 0; r < seeds; r++) {
+            row.ret += results[s * seeds + r].final.ret / seeds;
+            row.balanced += results[s * seeds + r].final.balanced / seeds;
+        }
+        summary.push_back(row);
+    }
+    std::sort(summary.begin(), summary.end(), [](const Summary& a, const Summary& b) { return a.ret > b.ret; });
+
+    std::cout << "Jobs: " << jobs.size() << " (" << settings.size() << " settings x " << seeds << " seeds)\n"
+              << "Threads: " << threads << "\n"
+              << "Wall time (s): " << elapsed.count() << "\n"
+              << "Results: " << outPath << "\n"
+              << "alpha,gamma,eps_c,angle_buckets,velocity_buckets,torque,tilings,eval_return,eval_balanced\n";
+    for (size_t k = 0; k < std::min<size_t>(summary.size(), 10); k++) {
+        const SweepConfig& c = settings[summary[k].setting];
+        std::cout << c.alpha << ',' << c.gamma << ',' << c.epsC << ',' << c.angleBuckets << ',' << c.velocityBuckets << ','
+                  << c.torque << ',' << c.tilings << ',' << summary[k].ret << ',' << summary[k].balanced << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,364 @@
+#include<string>
+#include<chrono>
+#include<iostream>
+#include "State.hpp"
+#include "Trainer.hpp"
+#include "Hogwild.hpp"
+#include "AllocCounter.hpp"
+#include "Checkpoint.hpp"
+#include "TransitionCache.hpp"
+#include "ReplayBuffer.hpp"
+#include "Pipeline.hpp"
+#include "Telemetry.hpp"
+#include "Trajectory.hpp"
+#include "Evaluate.hpp"
+#include "PrioritizedSweeping.hpp"
+
+// Headless SARSA trainer.  Runs the same learning loop as main() without a window so training
+// isn't tied to a display server or an event poll on every physics step.
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --episodes N   number of training episodes (default 1000)\n"
+              << "  --steps N      max actions per episode (default 1000)\n"
+              << "  --alpha X      SARSA step size (default 1)\n"
+              << "  --gamma X      discount factor (default 0.75)\n"
+              << "  --eps-c X      exploration constant (default EPSILON_C)\n"
+              << "  --tilings N    number of offset tilings, at most MAX_TILINGS (default NUM_TILINGS)\n"
+              << "  --lambda X     learn with SARSA(lambda) traces (single thread)\n"
+              << "  --watkins      use Watkins Q(lambda) instead of SARSA(lambda) with --lambda\n"
+              << "  --hash N       hash tiles into a table of N features instead of one per tile\n"
+              << "  --seed N       random seed; the same seed gives the same run on one thread (default 0)\n"
+              << "  --transition-cache  step each action with the interpolated TransitionCache (single thread)\n"
+              << "  --replay N     keep the last N transitions and replay minibatches of them (single thread)\n"
+              << "  --batch N      replayed transitions per action, at most MAX_REPLAY_BATCH (default 32)\n"
+              << "  --replay-alpha X  step size for replayed updates (default 0.1)\n"
+              << "  --prioritized  replay in proportion to TD error\n"
+              << "  --sweep N      prioritized sweeping: N model backups per action (needs --tilings 1, single thread)\n"
+              << "  --sweep-threshold X  smallest Bellman error that gets queued (default 0.001)\n"
+              << "  --threads N    train Hogwild-style on N threads sharing one table (default 1)\n"
+              << "  --actors N     simulate on N actor threads feeding one learner through SPSC queues\n"
+              << "  --load PATH    warm start from a checkpoint, keeping its hyperparameters and tiling\n"
+              << "  --save PATH    write a checkpoint when training finishes\n"
+              << "  --snapshot N   also write the checkpoint every N episodes (needs --save, single thread)\n"
+              << "  --save-format F  weights in checkpoints: f32 (default), fp16 or int8\n"
+              << "  --evaluate M   when training finishes, run the greedy policy from M seeded starts on every core\n"
+              << "  --telemetry PATH  write training counters and histograms to PATH as JSON lines\n"
+              << "  --telemetry-interval S  seconds between telemetry records (default 1)\n"
+              << "  --record PATH  log every action's state, action and reward to PATH for replay (single thread)\n"
+              << "  --check-allocs fail if any action after the first episode allocates (needs -DCOUNT_ALLOCS)\n";
+}
+
+int main(int argc, char** argv) {
+    size_t episodes = 1000;
+    size_t maxSteps = 1000;
+    float alpha = 1;
+    float gamma = 0.75;
+    double epsC = EPSILON_C;
+    int tilings = NUM_TILINGS;
+    size_t hashSize = 0;
+    bool shapeGiven = false;    // --tilings or --hash
+    float lambda = 0;
+    bool watkins = false;
+    uint64_t seed = 0;
+    int threads = 1;
+    int actors = 0;
+    std::string telemetryPath;
+    double telemetryInterval = 1;
+    std::string recordPath;
+    std::string loadPath, savePath;
+    size_t snapshotEvery = 0;
+    WeightFormat saveFormat = WeightFormat::f32;
+    size_t evalEpisodes = 0;
+    bool checkAllocs = false;
+    bool useCache = false;
+    size_t replayCapacity = 0;
+    int batch = 32;
+    float replayAlpha = 0.1;
+    bool prioritized = false;
+    int sweepBudget = 0;
+    float sweepThreshold = SWEEP_THRESHOLD;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--episodes" and hasValue)
+            episodes = std::stoul(argv[++i]);
+        else if (arg == "--steps" and hasValue)
+            maxSteps = std::stoul(argv[++i]);
+        else if (arg == "--alpha" and hasValue)
+            alpha = std::stof(argv[++i]);
+        else if (arg == "--gamma" and hasValue)
+            gamma = std::stof(argv[++i]);
+        else if (arg == "--eps-c" and hasValue)
+            epsC = std::stod(argv[++i]);
+        else if (arg == "--tilings" and hasValue) {
+            tilings = std::stoi(argv[++i]);
+            shapeGiven = true;
+        }
+        else if (arg == "--lambda" and hasValue)
+            lambda = std::stof(argv[++i]);
+        else if (arg == "--watkins")
+            watkins = true;
+        else if (arg == "--hash" and hasValue) {
+            hashSize = std::stoul(argv[++i]);
+            shapeGiven = true;
+        }
+        else if (arg == "--seed" and hasValue)
+            seed = std::stoull(argv[++i]);
+        else if (arg == "--threads" and hasValue)
+            threads = std::stoi(argv[++i]);
+        else if (arg == "--actors" and hasValue)
+            actors = std::stoi(argv[++i]);
+        else if (arg == "--telemetry" and hasValue)
+            telemetryPath = argv[++i];
+        else if (arg == "--telemetry-interval" and hasValue)
+            telemetryInterval = std::stod(argv[++i]);
+        else if (arg == "--record" and hasValue)
+            recordPath = argv[++i];
+        else if (arg == "--load" and hasValue)
+            loadPath = argv[++i];
+        else if (arg == "--save" and hasValue)
+            savePath = argv[++i];
+        else if (arg == "--snapshot" and hasValue)
+            snapshotEvery = std::stoul(argv[++i]);
+        else if (arg == "--sweep" and hasValue)
+            sweepBudget = std::stoi(argv[++i]);
+        else if (arg == "--sweep-threshold" and hasValue)
+            sweepThreshold = std::stof(argv[++i]);
+        else if (arg == "--evaluate" and hasValue)
+            evalEpisodes = std::stoul(argv[++i]);
+        else if (arg == "--save-format" and hasValue) {
+            std::string f = argv[++i];
+            if (f == "f32")
+                saveFormat = WeightFormat::f32;
+            else if (f == "fp16")
+                saveFormat = WeightFormat::f16;
+            else if (f == "int8")
+                saveFormat = WeightFormat::i8;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--replay" and hasValue)
+            replayCapacity = std::stoul(argv[++i]);
+        else if (arg == "--batch" and hasValue)
+            batch = std::stoi(argv[++i]);
+        else if (arg == "--replay-alpha" and hasValue)
+            replayAlpha = std::stof(argv[++i]);
+        else if (arg == "--prioritized")
+            prioritized = true;
+        else if (arg == "--transition-cache")
+            useCache = true;
+        else if (arg == "--check-allocs")
+            checkAllocs = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (checkAllocs and (not ALLOC_COUNTING or threads > 1 or actors > 0)) {
+        std::cerr << "--check-allocs needs a -DCOUNT_ALLOCS build and a single thread" << std::endl;
+        return 1;
+    }
+
+    if (snapshotEvery > 0 and (threads > 1 or actors > 0)) {
+        std::cerr << "--snapshot needs a single thread" << std::endl;
+        return 1;
+    }
+
+    if (shapeGiven and not loadPath.empty()) {
+        std::cerr << "--tilings and --hash can't be used with --load, which keeps the checkpoint's table" << std::endl;
+        return 1;
+    }
+
+    if (sweepBudget > 0 and (threads > 1 or actors > 0)) {
+        std::cerr << "--sweep needs a single thread" << std::endl;
+        return 1;
+    }
+
+    if (lambda > 0 and (threads > 1 or actors > 0)) {
+        std::cerr << "--lambda needs a single thread" << std::endl;
+        return 1;
+    }
+
+    if ((replayCapacity > 0 or prioritized) and (threads > 1 or actors > 0)) {
+        std::cerr << "--replay and --prioritized need a single thread" << std::endl;
+        return 1;
+    }
+
+    if (prioritized and replayCapacity == 0) {
+        std::cerr << "--prioritized needs --replay" << std::endl;
+        return 1;
+    }
+
+    if (useCache and (threads > 1 or actors > 0)) {
+        std::cerr << "--transition-cache needs a single thread" << std::endl;
+        return 1;
+    }
+
+    if (not recordPath.empty() and (threads > 1 or actors > 0)) {
+        std::cerr << "--record needs a single thread" << std::endl;
+        return 1;
+    }
+
+    seedThread(seed);
+    size_t step = 0;
+    std::unique_ptr<Agent> agent;
+    if (loadPath.empty()) {
+        agent = std::make_unique<Agent>(alpha, gamma, tilings, hashSize);
+    }
+    else {
+        auto ckpt = loadCheckpoint(loadPath);
+        if (ckpt.agent == nullptr)
+            return 1;
+        agent = std::move(ckpt.agent);
+        epsC = ckpt.epsC;
+        step = ckpt.step;
+    }
+    Agent& Bond = *agent;
+    if (lambda > 0)
+        Bond.setTraces(watkins ? TraceMode::watkins : TraceMode::sarsa, lambda);
+    size_t startStep = step;
+
+    std::unique_ptr<TransitionCache> cache;
+    if (useCache) {
+        cache = std::make_unique<TransitionCache>();
+        cache->precompute();
+    }
+    std::unique_ptr<TrainingMetrics> metrics;
+    if (not telemetryPath.empty()) {
+        metrics = std::make_unique<TrainingMetrics>();
+        if (not metrics->telemetry.start(telemetryPath, telemetryInterval))
+            return 1;
+    }
+    TrainingProbe probe(metrics.get());
+    TrajectoryRecorder recorder;
+    if (not recordPath.empty() and not recorder.open(recordPath))
+        return 1;
+
+    std::unique_ptr<ReplayBuffer> replay;
+    if (replayCapacity)
+        replay = std::make_unique<ReplayBuffer>(replayCapacity, prioritized);
+    std::unique_ptr<PrioritizedSweeping> sweeper;
+    if (sweepBudget > 0) {
+        if (not PrioritizedSweeping::supports(Bond.values())) {
+            std::cerr << "--sweep needs a one-tiling table without hashing (--tilings 1)" << std::endl;
+            return 1;
+        }
+        sweeper = std::make_unique<PrioritizedSweeping>(Bond.values(), Bond.discount(), sweepThreshold);
+    }
+    auto remember = [&](const State& prev, Action a, double reward, const State& next) {
+        probe.action(Bond.tdError());
+        recorder.record(step, next, a, reward);
+        if (replay) {
+            replay->push(prev, a, reward, next);
+            replayBatch(Bond, *replay, batch, replayAlpha);
+        }
+        if (sweeper) {
+            sweeper->observe(prev, a, reward, next);
+            sweeper->plan(sweepBudget);
+        }
+    };
+
+    auto advance = [&](State& x) {
+        if (cache)
+            (*cache)(x);
+        else
+            ExactDynamics()(x);
+    };
+
+    size_t broken = 0;
+    double totalReturn = 0;
+    size_t warmupSteps = 0;
+    size_t warmupAllocs = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    if (actors > 0) {
+        auto stats = trainPipelined(Bond, actors, episodes, maxSteps, epsC, seed, step, 1000, metrics.get());
+        step += stats.decisions;
+        broken = stats.broken;
+        totalReturn = stats.ret;
+        std::cout << "Snapshots published: " << stats.snapshots << "\n"
+                  << "Mean queue fill: " << stats.meanQueueFill << "\n"
+                  << "Max queue fill: " << stats.maxQueueFill << "\n"
+                  << "Actor waits on full queue: " << stats.fullWaits << "\n"
+                  << "Mean policy lag (updates): " << stats.meanLag << "\n"
+                  << "Max policy lag (updates): " << stats.maxLag << std::endl;
+    }
+    else if (threads > 1) {
+        auto stats = trainHogwild(Bond.values(), threads, episodes, maxSteps, Bond.stepSize(), Bond.discount(), epsC, seed, step, metrics.get());
+        step += stats.decisions;
+        broken = stats.broken;
+        totalReturn = stats.ret;
+    }
+    else {
+        for (size_t ep = 0; ep < episodes; ep++) {
+            State x0 = randomState();
+            recorder.beginEpisode(step, x0);
+            auto stats = runEpisode(Bond, x0, maxSteps, step, epsC, remember, advance);
+            probe.episode(stats.decisions, stats.ret, stats.broken);
+            totalReturn += stats.ret;
+            broken += stats.broken;
+            if (snapshotEvery and not savePath.empty() and (ep + 1) % snapshotEvery == 0)
+                saveCheckpoint(savePath, Bond, epsC, step, saveFormat);
+            // Everything after the first episode is steady state
+            if (ep == 0) {
+                warmupSteps = step;
+                warmupAllocs = allocations();
+            }
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (metrics)
+        metrics->telemetry.stop();
+    recorder.close();
+    size_t actions = step - startStep;
+    double physSteps = double(actions) * PHYSICS_STEPS_PER_ACTION;
+    size_t steadyAllocs = allocations() - warmupAllocs;
+
+    std::cout << "Threads: " << (actors > 0 ? actors + 1 : threads) << "\n"
+              << "Episodes: " << episodes << "\n"
+              << "Actions: " << actions << "\n"
+              << "Physics steps: " << physSteps << "\n"
+              << "Broken episodes: " << broken << "\n"
+              << "Mean episode length: " << double(actions) / episodes << "\n"
+              << "Mean return: " << totalReturn / episodes << "\n"
+              << "Wall time (s): " << elapsed.count() << "\n"
+              << "Actions/s: " << actions / elapsed.count() << "\n"
+              << "Physics steps/s: " << physSteps / elapsed.count() << "\n"
+              << "Simulated/wall time: " << physSteps * PHYSICS_TIMESTEP / elapsed.count() << std::endl;
+
+    if (sweeper)
+        std::cout << "Planning backups: " << sweeper->backupCount() << "\n"
+                  << "Backups per action: " << double(sweeper->backupCount()) / std::max<size_t>(actions, 1) << "\n"
+                  << "Still queued: " << sweeper->queued() << "\n"
+                  << "Model bytes: " << sweeper->bytes() << std::endl;
+
+    if (not recordPath.empty())
+        std::cout << "Recorded actions: " << recorder.recorded() << "\n"
+                  << "Bytes per record: " << double(recorder.size()) / std::max<size_t>(recorder.recorded(), 1) << "\n"
+                  << "Writer stalls: " << recorder.writerStalls() << std::endl;
+
+    if (ALLOC_COUNTING and threads == 1 and actors == 0) {
+        std::cout << "Steady-state allocations: " << steadyAllocs << " over " << step - warmupSteps << " actions" << std::endl;
+        if (checkAllocs and steadyAllocs != 0) {
+            std::cerr << "Training hot path allocated" << std::endl;
+            return 1;
+        }
+    }
+
+    if (not savePath.empty() and not saveCheckpoint(savePath, Bond, epsC, step, saveFormat))
+        return 1;
+
+    if (evalEpisodes) {
+        EvaluationConfig config;
+        config.episodes = evalEpisodes;
+        config.maxSteps = maxSteps;
+        printEvaluation(std::cout, evaluateParallel(Bond.values(), config));
+    }
+    return 0;
+}